@@ -32,7 +32,8 @@ void AsteroidField::Set(const System *system)
 
     for(const System::Asteroid &it : system->Asteroids())
     {
-        QPixmap sprite = SpriteSet::Get("asteroid/" + it.type + "/spin-00");
+        QString sprite = "asteroid/" + it.type + "/spin-00";
+        SpriteSet::Preload(sprite);
         for(int i = 0; i < it.count; ++i)
         {
             double angle = (rand() % 6283) * .001;
@@ -75,12 +76,21 @@ void AsteroidField::Draw(QPainter &painter, const QRectF &bounds) const
         for(int x = firstX; x <= lastX; ++x)
         {
             QVector2D offset(x * 4096., y * 4096.);
+            // Asteroids of the same type are next to each other in the list,
+            // so each sprite only needs to be looked up once.
+            QString name;
+            QPixmap sprite;
             for(const Asteroid &asteroid : asteroids)
             {
+                if(asteroid.sprite != name)
+                {
+                    name = asteroid.sprite;
+                    sprite = SpriteSet::Get(name);
+                }
                 QPointF thisOffset = (asteroid.position + offset).toPointF();
                 painter.translate(thisOffset);
                 painter.scale(.5, .5);
-                painter.drawPixmap(QPointF(), asteroid.sprite);
+                painter.drawPixmap(QPointF(), sprite);
                 painter.scale(2., 2.);
                 painter.translate(-thisOffset);
             }
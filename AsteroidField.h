@@ -13,7 +13,6 @@ PARTICULAR PURPOSE.  See the GNU General Public License for more details.
 #ifndef ASTEROIDFIELD_H
 #define ASTEROIDFIELD_H
 
-#include <QPixmap>
 #include <QString>
 #include <QVector2D>
 
@@ -38,7 +37,8 @@ private:
     public:
         QVector2D position;
         QVector2D velocity;
-        QPixmap sprite;
+        // The sprite is looked up when drawing, since it may still be loading.
+        QString sprite;
     };
 
 
@@ -0,0 +1,366 @@
+/* CommodityRandomizer.cpp
+Copyright (c) 2015 by Michael Zahniser
+
+Endless Sky is free software: you can redistribute it and/or modify it under the
+terms of the GNU General Public License as published by the Free Software
+Foundation, either version 3 of the License, or (at your option) any later version.
+
+Endless Sky is distributed in the hope that it will be useful, but WITHOUT ANY
+WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A
+PARTICULAR PURPOSE.  See the GNU General Public License for more details.
+*/
+
+#include "CommodityRandomizer.h"
+
+#include "Map.h"
+#include "Random.h"
+#include "System.h"
+
+#include <QHash>
+
+#include <algorithm>
+#include <map>
+#include <set>
+
+using namespace std;
+
+namespace {
+    // Commodity parameters.
+    const map<QString, int> BASE = {
+        {"Clothing", 140},
+        {"Electronics", 590},
+        {"Equipment", 330},
+        {"Food", 100},
+        {"Heavy Metals", 610},
+        {"Industrial", 520},
+        {"Luxury Goods", 920},
+        {"Medical", 430},
+        {"Metal", 190},
+        {"Plastic", 240}
+    };
+    const map<QString, vector<int>> BINS = {
+        {"Clothing", {20, 60, 20}},
+        {"Electronics", {30, 40, 30}},
+        {"Equipment", {30, 20, 20, 30}},
+        {"Food", {24, 18, 16, 18, 24}},
+        {"Heavy Metals", {8, 12, 20, 20, 20, 12, 8}},
+        {"Industrial", {20, 30, 30, 20}},
+        {"Luxury Goods", {25, 20, 15, 10, 10, 20}},
+        {"Medical", {20, 20, 20, 20, 20}},
+        {"Metal", {30, 25, 20, 25}},
+        {"Plastic", {40, 20, 40}}
+    };
+
+    // How many times a choice may be undone before giving up and starting
+    // over with a looser quota.
+    const int MAX_BACKTRACKS = 200;
+
+    // Find all the systems connected via hyperlinks to the given one.
+    vector<System *> Connected(Map &mapData, System *start)
+    {
+        map<QString, System> &all = mapData.Systems();
+        vector<System *> connected = {start};
+        set<const System *> found = {start};
+        for(size_t i = 0; i < connected.size(); ++i)
+            for(const QString &name : connected[i]->Links())
+            {
+                auto it = all.find(name);
+                if(it != all.end() && found.insert(&it->second).second)
+                    connected.push_back(&it->second);
+            }
+        return connected;
+    }
+
+    // A system's range of allowed bins, from before it was narrowed.
+    class Range {
+    public:
+        int system;
+        int low;
+        int high;
+    };
+
+    // A bin that was chosen for a system.
+    class Choice {
+    public:
+        int system;
+        int bin;
+        // The length of the undo trail before this choice was made.
+        size_t trailSize;
+        // Bins that were already tried for this system (one bit per bin).
+        unsigned tried;
+    };
+}
+
+
+
+CommodityRandomizer::CommodityRandomizer(Map &mapData, System *start)
+    : CommodityRandomizer(mapData, Connected(mapData, start))
+{
+}
+
+
+
+CommodityRandomizer::CommodityRandomizer(Map &mapData, const vector<System *> &region)
+    : systems(region)
+{
+    map<QString, System> &all = mapData.Systems();
+    QHash<const System *, int> index;
+    for(size_t i = 0; i < systems.size(); ++i)
+        index.insert(systems[i], i);
+
+    // Systems outside the region that link into it are numbered after the
+    // ones inside it. They only need to know their neighbors in the region.
+    vector<vector<int>> links(systems.size());
+    for(size_t i = 0; i < systems.size(); ++i)
+        for(const QString &name : systems[i]->Links())
+        {
+            auto it = all.find(name);
+            if(it == all.end())
+                continue;
+
+            const System *link = &it->second;
+            auto indexIt = index.find(link);
+            if(indexIt == index.end())
+            {
+                indexIt = index.insert(link, systems.size() + boundary.size());
+                boundary.push_back(link);
+                links.emplace_back();
+            }
+            links[i].push_back(*indexIt);
+            if(*indexIt >= static_cast<int>(systems.size()))
+                links[*indexIt].push_back(i);
+        }
+
+    first.push_back(0);
+    for(const vector<int> &list : links)
+    {
+        neighbors.insert(neighbors.end(), list.begin(), list.end());
+        first.push_back(neighbors.size());
+    }
+}
+
+
+
+bool CommodityRandomizer::CanRandomize(const QString &commodity)
+{
+    return BASE.count(commodity) && BINS.count(commodity);
+}
+
+
+
+const vector<System *> &CommodityRandomizer::Systems() const
+{
+    return systems;
+}
+
+
+
+vector<int> CommodityRandomizer::Randomize(const QString &commodity, Random &random) const
+{
+    auto baseIt = BASE.find(commodity);
+    auto binIt = BINS.find(commodity);
+    if(baseIt == BASE.end() || binIt == BINS.end())
+        return vector<int>();
+
+    const int base = baseIt->second;
+    const int bins = binIt->second.size();
+    const int count = systems.size();
+
+    // Systems on the boundary keep their prices. Figure out which bin each of
+    // those prices is in, so the systems next to them can match them.
+    vector<int> rough(count + boundary.size());
+    vector<int> fixed(boundary.size(), -1);
+    for(size_t i = 0; i < boundary.size(); ++i)
+    {
+        rough[count + i] = boundary[i]->Trade(commodity);
+        if(rough[count + i])
+            fixed[i] = min(bins - 1, max(0, (rough[count + i] - base) / 100));
+    }
+
+    // Try to find a set of bins to assign the systems to such that neighboring
+    // systems only differ by one bin, and the desired distribution is achieved.
+    vector<int> bin;
+    for(int tries = 0; true; ++tries)
+    {
+        // Each time we are unable to match the quota, loosen it by about one
+        // percent of the systems.
+        vector<int> quota;
+        for(int weight : binIt->second)
+            quota.emplace_back((count * weight) / 100 + tries * (count / 100 + 1) + 1);
+        if(AssignBins(quota, fixed, bin, random))
+            break;
+    }
+
+    // Assign each star system a value based on its bin.
+    for(int i = 0; i < count; ++i)
+        rough[i] = base + random.Int(100) + 100 * bin[i];
+
+    // Smooth out the values by averaging each system with the average of all
+    // its neighbors. Neighbors on the boundary that have no price for this
+    // commodity are left out.
+    vector<int> price(count);
+    for(int i = 0; i < count; ++i)
+    {
+        int links = 0;
+        int sum = 0;
+        for(int j = first[i]; j < first[i + 1]; ++j)
+            if(rough[neighbors[j]])
+            {
+                sum += rough[neighbors[j]];
+                ++links;
+            }
+
+        if(!links)
+            price[i] = rough[i];
+        else
+        {
+            sum += links * rough[i];
+            price[i] = (sum + links) / (2 * links);
+        }
+    }
+    return price;
+}
+
+
+
+// The system with the fewest bins left to choose from is assigned next, with
+// ties broken at random. Each choice narrows the range of bins its neighbors
+// may use, and that narrowing spreads outward only as far as it actually
+// changes something. If a system is left with no bin that has room in it, the
+// most recent choices are undone (using the trail of ranges they narrowed) and
+// other bins are tried for them.
+bool CommodityRandomizer::AssignBins(vector<int> quota, const vector<int> &fixed, vector<int> &bin,
+    Random &random) const
+{
+    const int count = systems.size();
+    vector<int> low(count + fixed.size(), 0);
+    vector<int> high(count + fixed.size(), quota.size());
+    bin.assign(count, -1);
+
+    // Systems waiting for a bin, grouped by how many bins they may use. A
+    // system is added again whenever its range changes, so an entry is stale
+    // (and is skipped) if the range no longer matches its group.
+    vector<vector<int>> waiting(quota.size() + 1);
+    vector<Range> trail;
+    vector<Choice> choices;
+    vector<int> frontier;
+
+    // Each neighbor of a system whose range narrowed must stay within one bin
+    // of that range. Only systems that actually changed are visited. The
+    // boundary's bins may be too far apart to satisfy that everywhere; if so,
+    // the constraint that cannot be met is skipped.
+    auto spread = [&]()
+    {
+        while(!frontier.empty())
+        {
+            const int source = frontier.back();
+            frontier.pop_back();
+            for(int j = first[source]; j < first[source + 1]; ++j)
+            {
+                const int link = neighbors[j];
+                const int newLow = max(low[link], low[source] - 1);
+                const int newHigh = min(high[link], high[source] + 1);
+                if(link >= count || newLow >= newHigh || (newLow == low[link] && newHigh == high[link]))
+                    continue;
+
+                trail.push_back({link, low[link], high[link]});
+                low[link] = newLow;
+                high[link] = newHigh;
+                waiting[newHigh - newLow].push_back(link);
+                frontier.push_back(link);
+            }
+        }
+    };
+
+    // Start from the bins of the systems on the boundary.
+    for(size_t i = 0; i < fixed.size(); ++i)
+        if(fixed[i] >= 0)
+        {
+            low[count + i] = fixed[i];
+            high[count + i] = fixed[i] + 1;
+            frontier.push_back(count + i);
+        }
+    spread();
+    for(int i = 0; i < count; ++i)
+        waiting[high[i] - low[i]].push_back(i);
+
+    // After a choice is undone, the same system is assigned again.
+    int retry = -1;
+    unsigned tried = 0;
+    int backtracks = 0;
+    while(static_cast<int>(choices.size()) < count)
+    {
+        int system = retry;
+        retry = -1;
+        for(size_t width = 1; system < 0 && width < waiting.size(); ++width)
+        {
+            vector<int> &group = waiting[width];
+            while(system < 0 && !group.empty())
+            {
+                int i = random.Int(group.size());
+                int candidate = group[i];
+                group[i] = group.back();
+                group.pop_back();
+                if(bin[candidate] < 0 && high[candidate] - low[candidate] == static_cast<int>(width))
+                    system = candidate;
+            }
+        }
+
+        // Pick a bin, based on what is available.
+        int possibilities = 0;
+        for(int i = low[system]; i < high[system]; ++i)
+            if(!(tried & (1u << i)))
+                possibilities += quota[i];
+        if(!possibilities)
+        {
+            if(choices.empty() || ++backtracks > MAX_BACKTRACKS)
+                return false;
+            waiting[high[system] - low[system]].push_back(system);
+
+            // Undo the most recent choice, and try some other bin for that
+            // system instead.
+            const Choice &last = choices.back();
+            while(trail.size() > last.trailSize)
+            {
+                const Range &range = trail.back();
+                low[range.system] = range.low;
+                high[range.system] = range.high;
+                waiting[range.high - range.low].push_back(range.system);
+                trail.pop_back();
+            }
+            bin[last.system] = -1;
+            ++quota[last.bin];
+            tried = last.tried | (1u << last.bin);
+            retry = last.system;
+            choices.pop_back();
+            continue;
+        }
+
+        // Pick a random one of those items to assign to it.
+        int index = random.Int(possibilities);
+        int choice = low[system];
+        while(true)
+        {
+            if(!(tried & (1u << choice)))
+            {
+                index -= quota[choice];
+                if(index < 0)
+                    break;
+            }
+            ++choice;
+        }
+        --quota[choice];
+
+        // Record our choice.
+        choices.push_back({system, choice, trail.size(), tried});
+        tried = 0;
+        bin[system] = choice;
+        trail.push_back({system, low[system], high[system]});
+        low[system] = choice;
+        high[system] = choice + 1;
+
+        frontier.push_back(system);
+        spread();
+    }
+    return true;
+}
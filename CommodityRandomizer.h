@@ -0,0 +1,74 @@
+/* CommodityRandomizer.h
+Copyright (c) 2015 by Michael Zahniser
+
+Endless Sky is free software: you can redistribute it and/or modify it under the
+terms of the GNU General Public License as published by the Free Software
+Foundation, either version 3 of the License, or (at your option) any later version.
+
+Endless Sky is distributed in the hope that it will be useful, but WITHOUT ANY
+WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A
+PARTICULAR PURPOSE.  See the GNU General Public License for more details.
+*/
+
+#ifndef COMMODITYRANDOMIZER_H
+#define COMMODITYRANDOMIZER_H
+
+#include <QString>
+
+#include <vector>
+
+class Map;
+class Random;
+class System;
+
+
+
+// Class that assigns random prices for a commodity to a group of connected
+// systems. Each system is put into one of the commodity's price bins, so that
+// the bins are filled in the desired proportions but neighboring systems are
+// never more than one bin apart. The prices are then smoothed out by
+// averaging each system with its neighbors. If only part of the map is being
+// randomized, the systems just outside it keep their prices, and the systems
+// next to them are kept within one bin of those prices.
+// The link graph is copied when this object is constructed, with the systems
+// numbered in order, so assigning the bins only touches flat arrays. Several
+// threads may randomize different commodities at once, each with its own
+// random number stream.
+class CommodityRandomizer {
+public:
+    // Gather all the systems that are connected by hyperlinks to the given one.
+    CommodityRandomizer(Map &mapData, System *start);
+    // Randomize only the given systems.
+    CommodityRandomizer(Map &mapData, const std::vector<System *> &region);
+
+    // Check if there are randomization parameters for the given commodity.
+    static bool CanRandomize(const QString &commodity);
+
+    // The systems being randomized, in the order that prices are returned in.
+    const std::vector<System *> &Systems() const;
+    // Pick new prices for the given commodity.
+    std::vector<int> Randomize(const QString &commodity, Random &random) const;
+
+
+private:
+    // Assign a bin to every system, with at most the given number of systems
+    // in each bin, given the bins of the boundary systems (or -1 for ones
+    // that have no price). Returns false if no assignment was found.
+    bool AssignBins(std::vector<int> quota, const std::vector<int> &fixed, std::vector<int> &bin,
+        Random &random) const;
+
+
+private:
+    std::vector<System *> systems;
+    // Systems outside the region that link to systems in it. In the link
+    // graph, they are numbered after the systems in the region.
+    std::vector<const System *> boundary;
+    // The neighbors of system i are neighbors[first[i]] up to (but not
+    // including) neighbors[first[i + 1]].
+    std::vector<int> first;
+    std::vector<int> neighbors;
+};
+
+
+
+#endif // COMMODITYRANDOMIZER_H
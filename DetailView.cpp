@@ -83,6 +83,8 @@ DetailView::DetailView(Map &mapData, GalaxyView *galaxyView, QWidget *parent) :
 
 
     setLayout(layout);
+
+    mapData.AddListener([this](const Map::Change &change) { MapChanged(change); });
 }
 
 
@@ -101,6 +103,7 @@ void DetailView::SetSystem(System *system)
         UpdateCommodities();
         UpdateFleets();
         UpdateMinables();
+        shownGeneration = system->Generation();
     }
     else
     {
@@ -153,6 +156,24 @@ void DetailView::UpdateMinables()
 
 void DetailView::UpdateCommodities()
 {
+    // If the table already lists every commodity, just change the prices
+    // rather than rebuilding all the spin boxes.
+    if(static_cast<size_t>(tradeWidget->topLevelItemCount()) == mapData.Commodities().size()
+            && spinMap.size() == mapData.Commodities().size())
+    {
+        for(int i = 0; i < tradeWidget->topLevelItemCount(); ++i)
+        {
+            QTreeWidgetItem *item = tradeWidget->topLevelItem(i);
+            QSpinBox *spin = static_cast<QSpinBox *>(tradeWidget->itemWidget(item, 1));
+            int price = system->Trade(item->text(0));
+            spin->blockSignals(true);
+            spin->setValue(price);
+            spin->blockSignals(false);
+            item->setText(2, mapData.PriceLevel(item->text(0), price));
+        }
+        return;
+    }
+
     QString current;
     if(tradeWidget && tradeWidget->currentItem())
         current = tradeWidget->currentItem()->text(0);
@@ -202,6 +223,7 @@ void DetailView::NameChanged()
         // Attempt the name change in GalaxyView, to update both this and SystemView.
         if(!galaxyView->RenameSystem(system->Name(), name->text()))
             name->setText(system->Name());
+        shownGeneration = system->Generation();
     }
     name->blockSignals(false);
 }
@@ -215,11 +237,10 @@ void DetailView::GovernmentChanged()
         return;
 
     system->SetGovernment(newGov);
+    shownGeneration = system->Generation();
+    // Color the Galaxy map by the new government.
     galaxyView->SetGovernment(newGov);
-    mapData.SetChanged();
-
-    // Refresh the Galaxy map since it is using a new Government color.
-    galaxyView->update();
+    mapData.Notify(Map::Change(Map::Change::GOVERNMENT_CHANGED, system));
 }
 
 
@@ -241,9 +262,9 @@ void DetailView::CommodityChanged(int value)
     tradeWidget->setCurrentItem(it->second);
     CommodityClicked(it->second, 0);
     system->SetTrade(it->second->text(0), value);
+    shownGeneration = system->Generation();
     it->second->setText(2, mapData.PriceLevel(it->second->text(0), value));
-    mapData.SetChanged();
-    galaxyView->update();
+    mapData.Notify(Map::Change(Map::Change::TRADE_CHANGED, system, it->second->text(0)));
 }
 
 
@@ -265,7 +286,8 @@ void DetailView::FleetChanged(QTreeWidgetItem *item, int column)
     else
         return;
 
-    mapData.SetChanged();
+    shownGeneration = system->Generation();
+    mapData.Notify(Map::Change(Map::Change::FLEETS_CHANGED, system));
 
     UpdateFleets();
 }
@@ -291,7 +313,8 @@ void DetailView::MinablesChanged(QTreeWidgetItem *item, int column)
     else
         return;
 
-    mapData.SetChanged();
+    shownGeneration = system->Generation();
+    mapData.Notify(Map::Change(Map::Change::MINABLES_CHANGED, system));
 
     UpdateMinables();
 }
@@ -327,3 +350,23 @@ void DetailView::UpdateFleets()
     connect(fleets, SIGNAL(itemChanged(QTreeWidgetItem *, int)),
         this, SLOT(FleetChanged(QTreeWidgetItem *, int)));
 }
+
+
+
+void DetailView::MapChanged(const Map::Change &change)
+{
+    // Changes made through this view, or to other systems, need no refresh.
+    if(!system || (change.system && change.system != system) || system->Generation() == shownGeneration)
+        return;
+
+    if(change.type == Map::Change::TRADE_CHANGED)
+        UpdateCommodities();
+    else if(change.type == Map::Change::GOVERNMENT_CHANGED)
+        government->setText(system->Government());
+    else if(change.type == Map::Change::MINABLES_CHANGED)
+        UpdateMinables();
+    else
+        return;
+
+    shownGeneration = system->Generation();
+}
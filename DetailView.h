@@ -13,6 +13,8 @@ PARTICULAR PURPOSE.  See the GNU General Public License for more details.
 #ifndef DETAILVIEW_H
 #define DETAILVIEW_H
 
+#include "Map.h"
+
 #include <QWidget>
 
 #include <QList>
@@ -20,7 +22,6 @@ PARTICULAR PURPOSE.  See the GNU General Public License for more details.
 #include <map>
 
 class GalaxyView;
-class Map;
 class System;
 
 class QLineEdit;
@@ -53,12 +54,16 @@ public slots:
 
 private:
     void UpdateFleets();
+    // Refresh whichever tables show data that another view edited.
+    void MapChanged(const Map::Change &change);
 
 
 private:
     Map &mapData;
     GalaxyView *galaxyView = nullptr;
     System *system = nullptr;
+    // The system generation that the tables currently reflect.
+    unsigned shownGeneration = 0;
 
     QLineEdit *name = nullptr;
     QLineEdit *government = nullptr;
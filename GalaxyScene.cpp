@@ -0,0 +1,463 @@
+/* GalaxyScene.cpp
+Copyright (c) 2015 by Michael Zahniser
+
+Endless Sky is free software: you can redistribute it and/or modify it under the
+terms of the GNU General Public License as published by the Free Software
+Foundation, either version 3 of the License, or (at your option) any later version.
+
+Endless Sky is distributed in the hope that it will be useful, but WITHOUT ANY
+WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A
+PARTICULAR PURPOSE.  See the GNU General Public License for more details.
+*/
+
+#include "GalaxyScene.h"
+
+#include "SpriteSet.h"
+#include "TileCache.h"
+
+#include <QBrush>
+#include <QFontMetricsF>
+#include <QPainter>
+#include <QPen>
+#include <QStaticText>
+#include <QTransform>
+
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <map>
+#include <set>
+#include <utility>
+
+using namespace std;
+
+const double GalaxyScene::LABEL_SCALE = .3;
+const double GalaxyScene::DOT_SCALE = .15;
+
+namespace {
+    // How far outside the view a system may be and still have its label show.
+    static const double LABEL_MARGIN = 150.;
+    // Labels are laid out for zoom levels a quarter of an octave apart.
+    static const int BUCKETS_PER_OCTAVE = 4;
+    // Size of the cells that the scene's content is split into.
+    static const double CELL_SIZE = 256.;
+    // Limit on how many labels each thread keeps laid out.
+    static const size_t MAX_LABELS = 20000;
+
+    atomic<int> labelGeneration(0);
+
+    // Each thread keeps its own cache of laid-out labels, because QStaticText
+    // may update its layout while it is being drawn, so it cannot be shared.
+    class LabelCache {
+    public:
+        int generation = -1;
+        map<pair<QString, int>, QStaticText> labels;
+    };
+    thread_local LabelCache labelCache;
+
+    // Get the zoom bucket that labels at the given scale are laid out for.
+    int LabelBucket(double scale)
+    {
+        return lround(log2(scale) * BUCKETS_PER_OCTAVE);
+    }
+
+    // Get the given font, resized for the given zoom bucket.
+    QFont LabelFont(QFont font, int bucket)
+    {
+        double scale = exp2(static_cast<double>(bucket) / BUCKETS_PER_OCTAVE);
+        if(font.pointSizeF() > 0.)
+            font.setPointSizeF(font.pointSizeF() * scale);
+        else
+            font.setPixelSize(max(1, static_cast<int>(lround(font.pixelSize() * scale))));
+        return font;
+    }
+
+    // Get the laid-out text for the given label.
+    const QStaticText &Label(const QString &name, int bucket, const QFont &font)
+    {
+        if(labelCache.generation != labelGeneration || labelCache.labels.size() > MAX_LABELS)
+        {
+            labelCache.labels.clear();
+            labelCache.generation = labelGeneration;
+        }
+
+        auto key = make_pair(name, bucket);
+        auto it = labelCache.labels.find(key);
+        if(it == labelCache.labels.end())
+        {
+            QStaticText text(name);
+            text.setTextFormat(Qt::PlainText);
+            text.setPerformanceHint(QStaticText::AggressiveCaching);
+            text.prepare(QTransform(), font);
+            it = labelCache.labels.emplace(key, text).first;
+        }
+        return it->second;
+    }
+
+    // Check if the line segment from a to b might be visible within the bounds.
+    bool Overlaps(const QRectF &bounds, const QPointF &a, const QPointF &b)
+    {
+        return max(a.x(), b.x()) >= bounds.left() && min(a.x(), b.x()) <= bounds.right()
+            && max(a.y(), b.y()) >= bounds.top() && min(a.y(), b.y()) <= bounds.bottom();
+    }
+
+    // Get the screen-space grid cell that a system at the given position is
+    // drawn in, when systems are drawn as dots.
+    pair<int, int> DotCell(const QPointF &position, double scale)
+    {
+        return make_pair(
+            static_cast<int>(floor(position.x() * scale / GalaxyScene::DOT_SIZE)),
+            static_cast<int>(floor(position.y() * scale / GalaxyScene::DOT_SIZE)));
+    }
+}
+
+
+
+// Set the font and resolution that labels are drawn with.
+void GalaxyScene::SetFont(const QFont &font, int dpiX, int dpiY)
+{
+    this->font = font;
+    this->dpiX = dpiX;
+    this->dpiY = dpiY;
+}
+
+
+
+void GalaxyScene::AddImage(const vector<QImage> &levels, const QPointF &center)
+{
+    if(levels.empty())
+        return;
+
+    QSizeF size = levels.front().size();
+    images.push_back({levels, QRectF(center - QPointF(.5 * size.width(), .5 * size.height()), size)});
+}
+
+
+
+// Add a link between the named systems. A link is shown once no matter
+// which of its systems it was added for, so only add it once.
+void GalaxyScene::AddLink(const QString &from, const QPointF &fromPosition,
+    const QString &to, const QPointF &toPosition, const QColor &color)
+{
+    QPointF middle = .5 * (fromPosition + toPosition);
+    EditCell(CellAt(middle)).links.push_back({from, to, fromPosition, toPosition, color});
+
+    QPointF reach = fromPosition - middle;
+    linkReach = max(linkReach, max(fabs(reach.x()), fabs(reach.y())));
+}
+
+
+
+// Add a system. The label bounds are relative to the system's position, in
+// map coordinates.
+void GalaxyScene::AddSystem(const QPointF &position, const QColor &color, const QString &name, const QRectF &label)
+{
+    Cell &cell = EditCell(CellAt(position));
+    cell.systems.emplace_back();
+    Star &star = cell.systems.back();
+    star.position = position;
+    star.color = color;
+    star.name = name;
+    star.label = label.translated(position);
+
+    labelReach = max(labelReach, max(max(fabs(label.left()), fabs(label.right())),
+        max(fabs(label.top()), fabs(label.bottom()))));
+    unplaced[name] = position;
+}
+
+
+
+// Remove the named system, which the scene has at the given position, and
+// any links to or from it. The names of the systems at the other ends of
+// those links are added to the given set.
+void GalaxyScene::RemoveSystem(const QString &name, const QPointF &position, set<QString> &linked)
+{
+    auto it = cells.find(CellAt(position));
+    if(it != cells.end())
+    {
+        const vector<Star> &systems = it->second->systems;
+        for(size_t i = 0; i < systems.size(); ++i)
+            if(systems[i].name == name)
+            {
+                // Any label that this one was hiding may be shown now.
+                if(systems[i].showLabel)
+                    for(const Star *other : LabelsNear(systems[i].label))
+                        if(name < other->name)
+                            unplaced[other->name] = other->position;
+
+                vector<Star> &edited = EditCell(it->first).systems;
+                edited.erase(edited.begin() + i);
+                break;
+            }
+    }
+
+    // The links to this system are in the cells within reach of it.
+    QRect range = CellRange(QRectF(position, position).adjusted(-linkReach, -linkReach, linkReach, linkReach));
+    for(int y = range.top(); y <= range.bottom(); ++y)
+        for(int x = range.left(); x <= range.right(); ++x)
+        {
+            auto cit = cells.find(CellKey(x, y));
+            if(cit == cells.end())
+                continue;
+
+            auto isLinked = [&name](const Link &link) { return link.from == name || link.to == name; };
+            const vector<Link> &links = cit->second->links;
+            if(none_of(links.begin(), links.end(), isLinked))
+                continue;
+
+            for(const Link &link : links)
+                if(isLinked(link))
+                    linked.insert(link.from == name ? link.to : link.from);
+            vector<Link> &edited = EditCell(cit->first).links;
+            edited.erase(remove_if(edited.begin(), edited.end(), isLinked), edited.end());
+        }
+}
+
+
+
+// Decide which labels to show, for every label near a system that was
+// added or removed since this was last called. A label is skipped if it
+// would overlap a shown label of a system whose name sorts before it.
+// Returns the bounds of every label that was shown or hidden. Hiding or
+// showing one label can affect others, so these areas may extend beyond
+// the part of the map that was edited.
+vector<QRectF> GalaxyScene::PlaceLabels()
+{
+    // The labels are checked in order by name, and a label that is shown or
+    // hidden only affects labels after it, so each label is final by the time
+    // it is checked. This gives the same result as checking every label.
+    vector<QRectF> changed;
+    while(!unplaced.empty())
+    {
+        QString name = unplaced.begin()->first;
+        CellKey key = CellAt(unplaced.begin()->second);
+        unplaced.erase(unplaced.begin());
+
+        auto it = cells.find(key);
+        if(it == cells.end())
+            continue;
+        const vector<Star> &systems = it->second->systems;
+        size_t index = find_if(systems.begin(), systems.end(),
+            [&name](const Star &star) { return star.name == name; }) - systems.begin();
+        if(index == systems.size())
+            continue;
+
+        vector<const Star *> near = LabelsNear(systems[index].label);
+        bool showLabel = none_of(near.begin(), near.end(),
+            [&name](const Star *other) { return other->showLabel && other->name < name; });
+        if(showLabel == systems[index].showLabel)
+            continue;
+
+        // Showing or hiding this label may change whether the labels after it
+        // that it overlaps are shown.
+        for(const Star *other : near)
+            if(name < other->name)
+                unplaced[other->name] = other->position;
+        Star &edited = EditCell(key).systems[index];
+        edited.showLabel = showLabel;
+        changed.push_back(edited.label);
+    }
+    return changed;
+}
+
+
+
+// Draw the content overlapping the given bounds (in map coordinates). The
+// painter must already be transformed to map coordinates at the given scale.
+void GalaxyScene::Draw(QPainter &painter, const QRectF &bounds, double scale) const
+{
+    // Draw the "galaxy" images, using the mip level closest to this scale.
+    const size_t level = SpriteSet::Level(scale);
+    for(const Image &it : images)
+        if(it.bounds.intersects(bounds))
+            painter.drawImage(it.bounds, it.levels[min(level, it.levels.size() - 1)]);
+
+    // Draw the links between systems.
+    painter.setBrush(Qt::NoBrush);
+    QRect range = CellRange(bounds.adjusted(-linkReach, -linkReach, linkReach, linkReach));
+    for(const auto &cell : cells)
+        if(range.contains(cell.first.first, cell.first.second))
+            for(const Link &it : cell.second->links)
+                if(Overlaps(bounds, it.fromPosition, it.toPosition))
+                {
+                    painter.setPen(QPen(it.color));
+                    painter.drawLine(it.fromPosition, it.toPosition);
+                }
+
+    // When zoomed far out, each system is drawn as a dot in a fixed grid of
+    // screen-space cells, and only the first system to land in each cell is
+    // drawn. Labels are only drawn when they are large enough to read.
+    bool drawDots = (scale < DOT_SCALE);
+    bool drawLabels = (scale >= LABEL_SCALE);
+    double margin = drawDots ? DOT_SIZE / scale : LABEL_MARGIN;
+    QRectF systemBounds = bounds.adjusted(-margin, -margin, margin, margin);
+    set<pair<int, int>> occupied;
+
+    QPen blackPen;
+    QPen brightPen(QColor(180, 180, 180));
+    painter.setPen(blackPen);
+    range = CellRange(systemBounds);
+    for(const auto &cell : cells)
+    {
+        if(!range.contains(cell.first.first, cell.first.second))
+            continue;
+
+        for(const Star &it : cell.second->systems)
+        {
+            if(!systemBounds.contains(it.position))
+                continue;
+
+            if(drawDots)
+            {
+                if(occupied.insert(DotCell(it.position, scale)).second)
+                    painter.fillRect(DotRect(it.position, scale), it.color);
+                continue;
+            }
+
+            painter.setBrush(QBrush(it.color));
+            painter.drawEllipse(it.position, 5, 5);
+        }
+    }
+    if(!drawLabels)
+        return;
+
+    // The labels are drawn unscaled, using a font sized for this zoom level.
+    int bucket = LabelBucket(scale);
+    QFont labelFont = LabelFont(font, bucket);
+    QFontMetricsF metrics(labelFont, painter.device());
+    QTransform transform = painter.transform();
+    painter.setTransform(QTransform::fromTranslate(transform.dx(), transform.dy()));
+    painter.setFont(labelFont);
+    for(const Star *it : LabelsNear(bounds))
+    {
+        if(!it->showLabel)
+            continue;
+
+        const QStaticText &label = Label(it->name, bucket, labelFont);
+        // The label's baseline is offset from the system's center.
+        QPointF corner = (it->position + QPointF(5., 5.)) * scale - QPointF(0., metrics.ascent());
+        painter.setPen(blackPen);
+        painter.drawStaticText(corner + QPointF(scale, scale), label);
+        painter.setPen(brightPen);
+        painter.drawStaticText(corner, label);
+    }
+    painter.setTransform(transform);
+}
+
+
+
+// Render the given tile (see TileCache) at the given scale.
+QImage GalaxyScene::RenderTile(int x, int y, double scale) const
+{
+    QImage image(TileCache::SIZE, TileCache::SIZE, QImage::Format_RGB32);
+    // Match the view's resolution so that text is the same size on the tile.
+    image.setDotsPerMeterX(qRound(dpiX / .0254));
+    image.setDotsPerMeterY(qRound(dpiY / .0254));
+    image.fill(Qt::black);
+
+    QPainter painter(&image);
+    painter.setFont(font);
+    painter.setRenderHint(QPainter::Antialiasing, true);
+    painter.setRenderHint(QPainter::SmoothPixmapTransform, true);
+    painter.translate(-x * TileCache::SIZE, -y * TileCache::SIZE);
+    painter.scale(scale, scale);
+
+    const double size = TileCache::SIZE / scale;
+    Draw(painter, QRectF(x * size, y * size, size, size), scale);
+    return image;
+}
+
+
+
+// Get the rectangle (in map coordinates) filled by the dot for a system at
+// the given position, when systems are drawn as dots.
+QRectF GalaxyScene::DotRect(const QPointF &position, double scale)
+{
+    pair<int, int> cell = DotCell(position, scale);
+    double size = DOT_SIZE / scale;
+    return QRectF(cell.first * size, cell.second * size, size, size);
+}
+
+
+
+// Get the bounds of the label with the given text, relative to its system,
+// in map coordinates. This covers the label at every zoom level where
+// labels are drawn, using the same fonts that they are drawn with.
+QRectF GalaxyScene::LabelBounds(const QFont &font, QPaintDevice *device, const QString &name)
+{
+    // Labels are drawn unscaled, in a font rounded to the nearest zoom bucket,
+    // so their size in map coordinates changes within each bucket. Cover the
+    // smallest and largest zoom level of each bucket that labels are drawn at.
+    // The galaxy view never zooms in past 100%.
+    QRectF bounds;
+    for(int bucket = LabelBucket(LABEL_SCALE); bucket <= LabelBucket(1.); ++bucket)
+    {
+        QRectF text = QFontMetricsF(LabelFont(font, bucket), device).boundingRect(name);
+        double low = max(LABEL_SCALE, exp2((bucket - .5) / BUCKETS_PER_OCTAVE));
+        double high = min(1., exp2((bucket + .5) / BUCKETS_PER_OCTAVE));
+        for(double scale : {low, high})
+            bounds |= QRectF(text.topLeft() / scale, text.bottomRight() / scale);
+    }
+    // The label's baseline is at (5, 5), and its shadow is offset by one more.
+    return bounds.translated(5., 5.).adjusted(0., 0., 1., 1.);
+}
+
+
+
+// Discard the labels cached by every thread. This must be called whenever
+// a system is renamed.
+void GalaxyScene::InvalidateLabels()
+{
+    ++labelGeneration;
+}
+
+
+
+GalaxyScene::CellKey GalaxyScene::CellAt(const QPointF &point)
+{
+    return CellKey(static_cast<int>(floor(point.x() / CELL_SIZE)), static_cast<int>(floor(point.y() / CELL_SIZE)));
+}
+
+
+
+// Get the given cell for editing. If other scenes share it, this scene
+// gets its own copy of it first.
+GalaxyScene::Cell &GalaxyScene::EditCell(const CellKey &key)
+{
+    shared_ptr<Cell> &cell = cells[key];
+    if(!cell)
+        cell.reset(new Cell);
+    else if(cell.use_count() > 1)
+        cell.reset(new Cell(*cell));
+    return *cell;
+}
+
+
+
+// Get the (inclusive) range of cells that covers the given rectangle.
+QRect GalaxyScene::CellRange(const QRectF &bounds)
+{
+    QRectF rect = bounds.normalized();
+    return QRect(
+        QPoint(floor(rect.left() / CELL_SIZE), floor(rect.top() / CELL_SIZE)),
+        QPoint(floor(rect.right() / CELL_SIZE), floor(rect.bottom() / CELL_SIZE)));
+}
+
+
+
+// Get the systems whose labels overlap the given rectangle.
+vector<const GalaxyScene::Star *> GalaxyScene::LabelsNear(const QRectF &bounds) const
+{
+    vector<const Star *> near;
+    QRect range = CellRange(bounds.adjusted(-labelReach, -labelReach, labelReach, labelReach));
+    for(int y = range.top(); y <= range.bottom(); ++y)
+        for(int x = range.left(); x <= range.right(); ++x)
+        {
+            auto it = cells.find(CellKey(x, y));
+            if(it != cells.end())
+                for(const Star &star : it->second->systems)
+                    if(star.label.intersects(bounds))
+                        near.push_back(&star);
+        }
+    return near;
+}
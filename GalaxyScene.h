@@ -0,0 +1,153 @@
+/* GalaxyScene.h
+Copyright (c) 2015 by Michael Zahniser
+
+Endless Sky is free software: you can redistribute it and/or modify it under the
+terms of the GNU General Public License as published by the Free Software
+Foundation, either version 3 of the License, or (at your option) any later version.
+
+Endless Sky is distributed in the hope that it will be useful, but WITHOUT ANY
+WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A
+PARTICULAR PURPOSE.  See the GNU General Public License for more details.
+*/
+
+#ifndef GALAXYSCENE_H
+#define GALAXYSCENE_H
+
+#include <QColor>
+#include <QFont>
+#include <QImage>
+#include <QPointF>
+#include <QRect>
+#include <QRectF>
+#include <QString>
+
+#include <map>
+#include <memory>
+#include <set>
+#include <utility>
+#include <vector>
+
+class QPaintDevice;
+class QPainter;
+
+
+
+// Class holding a snapshot of everything in the static layer of the galaxy map:
+// the galaxy images, links, systems, and labels, with their colors already
+// chosen. Once a scene is given to worker threads to render tiles from, it is
+// never modified. Instead, an edit is made to a copy of the scene. The content
+// is split into square cells that copies share until one of them changes a
+// cell, so a copy only costs as much as the cells that the edit touches.
+class GalaxyScene {
+public:
+    // Below this zoom level, system names are too small to read.
+    static const double LABEL_SCALE;
+    // Below this zoom level, systems are drawn as merged screen-space dots.
+    static const double DOT_SCALE;
+    // Size of a system dot, in pixels. This evenly divides the tile size.
+    static const int DOT_SIZE = 4;
+
+
+public:
+    // Set the font and resolution that labels are drawn with.
+    void SetFont(const QFont &font, int dpiX, int dpiY);
+    // Add an image, given its mip levels (see SpriteSet).
+    void AddImage(const std::vector<QImage> &levels, const QPointF &center);
+    // Add a link between the named systems. A link is shown once no matter
+    // which of its systems it was added for, so only add it once.
+    void AddLink(const QString &from, const QPointF &fromPosition,
+        const QString &to, const QPointF &toPosition, const QColor &color);
+    // Add a system. The label bounds are relative to the system's position, in
+    // map coordinates.
+    void AddSystem(const QPointF &position, const QColor &color, const QString &name, const QRectF &label);
+    // Remove the named system, which the scene has at the given position, and
+    // any links to or from it. The names of the systems at the other ends of
+    // those links are added to the given set.
+    void RemoveSystem(const QString &name, const QPointF &position, std::set<QString> &linked);
+    // Decide which labels to show, for every label near a system that was
+    // added or removed since this was last called. A label is skipped if it
+    // would overlap a shown label of a system whose name sorts before it.
+    // Returns the bounds of every label that was shown or hidden. Hiding or
+    // showing one label can affect others, so these areas may extend beyond
+    // the part of the map that was edited.
+    std::vector<QRectF> PlaceLabels();
+
+    // Draw the content overlapping the given bounds (in map coordinates). The
+    // painter must already be transformed to map coordinates at the given scale.
+    void Draw(QPainter &painter, const QRectF &bounds, double scale) const;
+    // Render the given tile (see TileCache) at the given scale.
+    QImage RenderTile(int x, int y, double scale) const;
+
+    // Get the rectangle (in map coordinates) filled by the dot for a system at
+    // the given position, when systems are drawn as dots.
+    static QRectF DotRect(const QPointF &position, double scale);
+    // Get the bounds of the label with the given text, relative to its system,
+    // in map coordinates. This covers the label at every zoom level where
+    // labels are drawn, using the same fonts that they are drawn with.
+    static QRectF LabelBounds(const QFont &font, QPaintDevice *device, const QString &name);
+
+    // Discard the labels cached by every thread. This must be called whenever
+    // a system is renamed.
+    static void InvalidateLabels();
+
+
+private:
+    class Image {
+    public:
+        std::vector<QImage> levels;
+        QRectF bounds;
+    };
+    class Link {
+    public:
+        QString from;
+        QString to;
+        QPointF fromPosition;
+        QPointF toPosition;
+        QColor color;
+    };
+    class Star {
+    public:
+        QPointF position;
+        QColor color;
+        QString name;
+        QRectF label;
+        bool showLabel = false;
+    };
+    // Each system is stored in the cell that contains it, and each link in the
+    // cell that contains its midpoint.
+    class Cell {
+    public:
+        std::vector<Link> links;
+        std::vector<Star> systems;
+    };
+    typedef std::pair<int, int> CellKey;
+
+
+private:
+    static CellKey CellAt(const QPointF &point);
+    // Get the given cell for editing. If other scenes share it, this scene
+    // gets its own copy of it first.
+    Cell &EditCell(const CellKey &key);
+    // Get the (inclusive) range of cells that covers the given rectangle.
+    static QRect CellRange(const QRectF &bounds);
+    // Get the systems whose labels overlap the given rectangle.
+    std::vector<const Star *> LabelsNear(const QRectF &bounds) const;
+
+
+private:
+    QFont font;
+    int dpiX = 96;
+    int dpiY = 96;
+
+    std::vector<Image> images;
+    std::map<CellKey, std::shared_ptr<Cell>> cells;
+    // How far from its cell anything stored in a cell may reach.
+    double linkReach = 0.;
+    double labelReach = 0.;
+    // Labels that PlaceLabels() must check, and where their systems are.
+    std::map<QString, QPointF> unplaced;
+};
+
+
+
+#endif // GALAXYSCENE_H
@@ -12,28 +12,121 @@ PARTICULAR PURPOSE.  See the GNU General Public License for more details.
 
 #include "GalaxyView.h"
 
+#include "CommodityRandomizer.h"
 #include "DetailView.h"
+#include "GalaxyScene.h"
 #include "Map.h"
+#include "Random.h"
+#include "SpriteQueue.h"
 #include "SpriteSet.h"
 #include "SystemView.h"
 
 #include <QInputDialog>
 #include <QMessageBox>
+#include <QPaintEvent>
 #include <QPainter>
 #include <QPalette>
 #include <QMouseEvent>
+#include <QRegion>
+#include <QRunnable>
+#include <QStringList>
 #include <QTabWidget>
 #include <QVector2D>
 
 #include <algorithm>
 #include <cmath>
+#include <limits>
 #include <map>
+#include <memory>
 #include <set>
-#include <stack>
+#include <utility>
+#include <vector>
 
 using namespace std;
 
 namespace {
+    // Keep at least this many rendered tiles cached.
+    static const int MAX_TILES = 64;
+    // Length, in pixels, of the pieces that links are split into when
+    // figuring out which tiles they pass through.
+    static const double LINK_PIECE = 128.;
+
+    // Job that renders one tile of a galaxy scene in a worker thread, then
+    // hands the result back to the view in the GUI thread.
+    class TileJob : public QRunnable {
+    public:
+        TileJob(QObject *view, const shared_ptr<const GalaxyScene> &scene, double scale,
+                int x, int y, const TileCache::Ticket &ticket)
+            : view(view), scene(scene), scale(scale), x(x), y(y), ticket(ticket) {}
+
+        virtual void run() override
+        {
+            if(*ticket.cancelled)
+                return;
+            QImage image = scene->RenderTile(x, y, scale);
+            if(*ticket.cancelled)
+                return;
+            QMetaObject::invokeMethod(view, "TileFinished", Qt::QueuedConnection,
+                Q_ARG(int, x), Q_ARG(int, y), Q_ARG(double, scale),
+                Q_ARG(int, ticket.version), Q_ARG(QImage, image));
+        }
+
+    private:
+        QObject *view;
+        shared_ptr<const GalaxyScene> scene;
+        double scale;
+        int x;
+        int y;
+        TileCache::Ticket ticket;
+    };
+
+    // Job that picks new prices for one commodity, using its own stream of
+    // random numbers.
+    class RandomizeJob : public QRunnable {
+    public:
+        RandomizeJob(const CommodityRandomizer &randomizer, const QString &commodity,
+                quint64 seed, quint64 stream, vector<int> &prices)
+            : randomizer(randomizer), commodity(commodity), seed(seed), stream(stream), prices(prices) {}
+
+        virtual void run() override
+        {
+            Random random(seed, stream);
+            prices = randomizer.Randomize(commodity, random);
+        }
+
+    private:
+        const CommodityRandomizer &randomizer;
+        QString commodity;
+        quint64 seed;
+        quint64 stream;
+        vector<int> &prices;
+    };
+
+    // Job that regenerates one system's stellar objects, asteroids, and
+    // minables. It works on its own copy of the system, with this thread's
+    // random number stream reseeded so the result depends only on the seed.
+    class GenerateJob : public QRunnable {
+    public:
+        GenerateJob(System &system, quint64 seed, quint64 stream, bool allowHabitable, bool requireHabitable)
+            : system(system), seed(seed), stream(stream),
+            allowHabitable(allowHabitable), requireHabitable(requireHabitable) {}
+
+        virtual void run() override
+        {
+            Random::Local() = Random(seed, stream);
+            system.Randomize(allowHabitable, requireHabitable);
+            system.ChangeAsteroids();
+            system.ChangeMinables();
+        }
+
+    private:
+        System &system;
+        quint64 seed;
+        quint64 stream;
+        bool allowHabitable;
+        bool requireHabitable;
+    };
+
     // Map a value between -1 and 1 to a color.
     QColor MapColor(double value)
     {
@@ -57,6 +150,27 @@ namespace {
             200. * value + 55.9,
             200. * value + 55.9);
     }
+
+    // Find all the systems within the given number of jumps of the given one.
+    vector<System *> SystemsNear(Map &mapData, System *start, int jumps)
+    {
+        vector<System *> found = {start};
+        set<const System *> visited = {start};
+        size_t begin = 0;
+        for(int distance = 0; distance < jumps; ++distance)
+        {
+            size_t end = found.size();
+            for(size_t i = begin; i < end; ++i)
+                for(const QString &name : found[i]->Links())
+                {
+                    auto it = mapData.Systems().find(name);
+                    if(it != mapData.Systems().end() && visited.insert(&it->second).second)
+                        found.push_back(&it->second);
+                }
+            begin = end;
+        }
+        return found;
+    }
 }
 
 
@@ -72,11 +186,22 @@ GalaxyView::GalaxyView(Map &mapData, QTabWidget *tabs, QWidget *parent) :
         "Right click to create a new system or to toggle links between systems.\n"
         "Use the scroll wheel to zoom in and out.");
 
+    mapData.AddListener([this](const Map::Change &change) { MapChanged(change); });
+    connect(&SpriteQueue::Instance(), SIGNAL(Loaded(const QString &)), this, SLOT(SpriteLoaded(const QString &)));
     Center();
 }
 
 
 
+GalaxyView::~GalaxyView()
+{
+    // Drop any queued tile renders, and let the ones in progress finish.
+    pool.clear();
+    pool.waitForDone();
+}
+
+
+
 void GalaxyView::Center()
 {
     if(mapData.Systems().empty())
@@ -112,6 +237,7 @@ void GalaxyView::SetCommodity(const QString &name)
     {
         commodity = name;
         government.clear();
+        InvalidateAll();
         update();
     }
 }
@@ -125,6 +251,7 @@ void GalaxyView::SetGovernment(const QString &name)
     {
         government = name;
         commodity.clear();
+        InvalidateAll();
         update();
     }
 }
@@ -159,9 +286,7 @@ bool GalaxyView::RenameSystem(const QString &from, const QString &to)
     {
         QMessageBox::warning(this, "Missing name",
             "A system named \"" + from + "\" didn't exist.");
-        mapData.Systems()[from];
-        mapData.SetChanged();
-        update();
+        mapData.Notify(Map::Change(Map::Change::SYSTEM_ADDED, &mapData.Systems()[from]));
         return false;
     }
     // If the desired name is empty, prompt to delete the system.
@@ -181,7 +306,6 @@ bool GalaxyView::RenameSystem(const QString &from, const QString &to)
     else
     {
         mapData.RenameSystem(from, to);
-        mapData.SetChanged();
 
         // Update the system pointed to by the two views, as the old pointer is invalid.
         System *newSystem = &mapData.Systems()[to];
@@ -189,9 +313,7 @@ bool GalaxyView::RenameSystem(const QString &from, const QString &to)
             systemView->Select(newSystem);
         if(detailView)
             detailView->SetSystem(newSystem);
-
-        // Redraw the Galaxy map using the new system's name.
-        update();
+        mapData.Notify(Map::Change(Map::Change::SYSTEM_RENAMED, newSystem, from));
     }
 
     return true;
@@ -211,7 +333,9 @@ void GalaxyView::DeleteSystem()
     if(button == QMessageBox::Yes)
     {
         // Deselect this system.
+        update(SelectionRect());
         systemView->Select(nullptr);
+        mapData.Notify(Map::Change(Map::Change::SYSTEM_REMOVED, system));
         // Remove all links from this system (and the corresponding return links, if able).
         while(!system->Links().empty())
         {
@@ -226,9 +350,7 @@ void GalaxyView::DeleteSystem()
 
         // Remove this system from known systems.
         mapData.Systems().erase(system->Name());
-        mapData.SetChanged();
     }
-    update();
 }
 
 
@@ -243,188 +365,150 @@ void GalaxyView::Recenter()
 
 void GalaxyView::RandomizeCommodity()
 {
-    // Randomize the values of the currently selected commodity.
-    
-    // First, make sure a system and a commodity are selected.
+    // Randomize the values of the currently selected commodity, for all the
+    // systems connected via hyperlinks to the selected system.
     if(commodity.isEmpty() || !systemView || !systemView->Selected())
         return;
-    
-    // Next, find all the systems connected via hyperlinks to the current system.
-    set<System *> connected;
-    stack<System *> edge;
-    edge.push(systemView->Selected());
-    while(!edge.empty())
-    {
-        System *system = edge.top();
-        edge.pop();
-        
-        if(connected.count(system))
-            continue;
-        connected.insert(system);
-        
-        for(const QString &name : system->Links())
-            if(mapData.Systems().count(name))
-                edge.push(&mapData.Systems()[name]);
-    }
-    
-    // Commodity parameters.
-    static const map<QString, int> BASE = {
-        {"Clothing", 140},
-        {"Electronics", 590},
-        {"Equipment", 330},
-        {"Food", 100},
-        {"Heavy Metals", 610},
-        {"Industrial", 520},
-        {"Luxury Goods", 920},
-        {"Medical", 430},
-        {"Metal", 190},
-        {"Plastic", 240}
-    };
-    static const map<QString, vector<int>> BINS = {
-        {"Clothing", {20, 60, 20}},
-        {"Electronics", {30, 40, 30}},
-        {"Equipment", {30, 20, 20, 30}},
-        {"Food", {24, 18, 16, 18, 24}},
-        {"Heavy Metals", {8, 12, 20, 20, 20, 12, 8}},
-        {"Industrial", {20, 30, 30, 20}},
-        {"Luxury Goods", {25, 20, 15, 10, 10, 20}},
-        {"Medical", {20, 20, 20, 20, 20}},
-        {"Metal", {30, 25, 20, 25}},
-        {"Plastic", {40, 20, 40}}
-    };
-    auto baseIt = BASE.find(commodity);
-    auto binIt = BINS.find(commodity);
-    if(baseIt == BASE.end() || binIt == BINS.end())
+    if(!CommodityRandomizer::CanRandomize(commodity))
         return;
-    
-    // Generate the quotas for each bin level.
-    const int base = baseIt->second;
-    
-    // Try to find a set of bins to assign the systems to such that neighboring
-    // systems only differ by one bin, and the desired distribution is achieved.
-    map<const System *, int> bin;
-    for(int tries = 0; true; ++tries)
+
+    RandomizeCommodity(CommodityRandomizer(mapData, systemView->Selected()));
+}
+
+
+
+// Randomize the selected commodity only for systems within some number of
+// jumps of the selected system. Systems just outside that range keep their
+// prices, so the rest of the map is unaffected.
+void GalaxyView::RandomizeCommodityNearby()
+{
+    if(commodity.isEmpty() || !systemView || !systemView->Selected())
+        return;
+    if(!CommodityRandomizer::CanRandomize(commodity))
+        return;
+
+    bool ok = false;
+    int jumps = QInputDialog::getInt(this, "Randomize commodity nearby", "Jumps from the selected system:",
+        3, 0, 100, 1, &ok);
+    if(!ok)
+        return;
+
+    RandomizeCommodity(CommodityRandomizer(mapData, SystemsNear(mapData, systemView->Selected(), jumps)));
+}
+
+
+
+// Randomize the selected commodity only for systems with the same government
+// as the selected system.
+void GalaxyView::RandomizeCommodityInGovernment()
+{
+    if(commodity.isEmpty() || !systemView || !systemView->Selected())
+        return;
+    if(!CommodityRandomizer::CanRandomize(commodity))
+        return;
+
+    vector<System *> region;
+    const QString &government = systemView->Selected()->Government();
+    for(auto &it : mapData.Systems())
+        if(it.second.Government() == government)
+            region.push_back(&it.second);
+
+    RandomizeCommodity(CommodityRandomizer(mapData, region));
+}
+
+
+
+// Randomize every commodity for the systems connected to the selected one.
+// Each commodity is randomized in its own thread, with a random number stream
+// that depends only on the seed and the commodity's place in the list, so the
+// same seed always gives the same prices.
+void GalaxyView::RandomizeAllCommodities()
+{
+    if(!systemView || !systemView->Selected())
+        return;
+
+    bool ok = false;
+    int seed = QInputDialog::getInt(this, "Randomize all commodities", "Seed:",
+        Random::NewSeed() % numeric_limits<int>::max(), 0, numeric_limits<int>::max(), 1, &ok);
+    if(!ok)
+        return;
+
+    CommodityRandomizer randomizer(mapData, systemView->Selected());
+    const vector<Map::Commodity> &commodities = mapData.Commodities();
+    vector<vector<int>> prices(commodities.size());
     {
-        // Each time we try 4 times to match the quota and are unable to,
-        // loosen the quota a little bit.
-        vector<int> quota;
-        for(int weight : binIt->second)
-            quota.emplace_back((connected.size() * weight) / 100 + tries / 4 + 1);
-        
-        vector<const System *> unassigned;
-        map<const System *, int> low;
-        map<const System *, int> high;
-        for(const System *system : connected)
-        {
-            unassigned.push_back(system);
-            low[system] = 0;
-            high[system] = quota.size();
-        }
-        
-        while(!unassigned.empty())
-        {
-            int i = rand() % unassigned.size();
-            const System *system = unassigned[i];
-            unassigned[i] = unassigned.back();
-            unassigned.pop_back();
-            
-            // Pick a bin, based on what is available.
-            int possibilities = 0;
-            for(int i = low[system]; i < high[system]; ++i)
-                possibilities += quota[i];
-            if(!possibilities)
-                break;
-            
-            // Pick a random one of those items to assign to it.
-            int index = rand() % possibilities;
-            int choice = low[system];
-            while(true)
+        QThreadPool workers;
+        for(size_t i = 0; i < commodities.size(); ++i)
+            if(CommodityRandomizer::CanRandomize(commodities[i].name))
             {
-                index -= quota[choice];
-                if(index < 0)
-                    break;
-                ++choice;
+                RandomizeJob *job = new RandomizeJob(randomizer, commodities[i].name, seed, i, prices[i]);
+                workers.start(job);
             }
-            --quota[choice];
-            
-            // Record our choice.
-            bin[system] = choice;
-            int newLow = low[system] = choice;
-            int newHigh = high[system] = choice + 1;
-            
-            // Starting from this star, trace outwards system by system. Each
-            // neighboring system must be within 1 of this star's level; each
-            // system neighboring those, within 2, and so on.
-            vector<const System *> sources = {system};
-            set<const System *> done = {system};
-            while(!sources.empty())
-            {
-                // For each step outward, expand the allowable range.
-                --newLow;
-                ++newHigh;
-                
-                vector<const System *> next;
-                
-                // Check if any systems adjacent to any of the sources must be
-                // updated.
-                for(const System *source : sources)
-                    for(const QString &name : source->Links())
-                    {
-                        auto it = mapData.Systems().find(name);
-                        if(it == mapData.Systems().end() || done.count(&it->second))
-                            continue;
-                        const System *link = &it->second;
-                        done.insert(link);
-                        
-                        // No need to go further if this system is already at
-                        // least as constrained as the new constraints.
-                        if(low[link] >= newLow && high[link] <= newHigh)
-                            continue;
-                        
-                        low[link] = max(low[link], newLow);
-                        high[link] = min(high[link], newHigh);
-                        next.push_back(link);
-                    }
-                
-                // Now, visit neighbors of those neighbors.
-                next.swap(sources);
-            }
-        }
-        if(unassigned.empty())
-            break;
+        workers.waitForDone();
     }
-    
-    // Assign each star system a value based on its bin.
-    map<const System *, int> rough;
-    for(const auto &it : bin)
-        rough[it.first] = base + (rand() % 100) + 100 * it.second;
-    
-    // Smooth out the values by averaging each system with the average of all
-    // its neighbors.
-    for(System *system : connected)
-    {
-        int count = 0;
-        int sum = 0;
-        for(const QString &link : system->Links())
-            if(mapData.Systems().count(link))
-            {
-                sum += rough[&mapData.Systems()[link]];
-                ++count;
-            }
 
-        if(!count)
-            sum = rough[system];
-        else
+    // Only change the map once every commodity is done.
+    for(size_t i = 0; i < commodities.size(); ++i)
+        for(size_t j = 0; j < prices[i].size(); ++j)
+            randomizer.Systems()[j]->SetTrade(commodities[i].name, prices[i][j]);
+    mapData.Notify(Map::Change(Map::Change::TRADE_CHANGED));
+}
+
+
+
+// Regenerate every system within some number of jumps of the selected one.
+// The systems are generated in parallel, each from its own random number
+// stream, and the map is only changed once all of them are done.
+void GalaxyView::GenerateSystems()
+{
+    if(!systemView || !systemView->Selected())
+        return;
+
+    bool ok = false;
+    int jumps = QInputDialog::getInt(this, "Regenerate systems", "Jumps from the selected system:",
+        2, 0, 100, 1, &ok);
+    if(!ok)
+        return;
+    static const QStringList KINDS = {"Any", "Inhabited", "Uninhabited"};
+    QString kind = QInputDialog::getItem(this, "Regenerate systems", "Systems:", KINDS, 0, false, &ok);
+    if(!ok)
+        return;
+    int seed = QInputDialog::getInt(this, "Regenerate systems", "Seed:",
+        Random::NewSeed() % numeric_limits<int>::max(), 0, numeric_limits<int>::max(), 1, &ok);
+    if(!ok)
+        return;
+
+    bool allowHabitable = (kind != "Uninhabited");
+    bool requireHabitable = (kind == "Inhabited");
+    vector<System *> targets = SystemsNear(mapData, systemView->Selected(), jumps);
+    vector<System> results(targets.size());
+    {
+        QThreadPool workers;
+        for(size_t i = 0; i < targets.size(); ++i)
         {
-            sum += count * rough[system];
-            sum = (sum + count) / (2 * count);
+            results[i] = *targets[i];
+            workers.start(new GenerateJob(results[i], seed, i, allowHabitable, requireHabitable));
         }
-        system->SetTrade(commodity, sum);
+        workers.waitForDone();
     }
-    mapData.SetChanged();
-    if(detailView)
-        detailView->UpdateCommodities();
-    update();
+
+    for(size_t i = 0; i < targets.size(); ++i)
+        *targets[i] = results[i];
+    // The system view may be showing one of the systems that was replaced.
+    systemView->Select(systemView->Selected());
+    mapData.Notify(Map::Change(Map::Change::OBJECTS_CHANGED));
+    mapData.Notify(Map::Change(Map::Change::MINABLES_CHANGED));
+}
+
+
+
+void GalaxyView::RandomizeCommodity(const CommodityRandomizer &randomizer)
+{
+    Random random(Random::NewSeed());
+    vector<int> prices = randomizer.Randomize(commodity, random);
+    for(size_t i = 0; i < prices.size(); ++i)
+        randomizer.Systems()[i]->SetTrade(commodity, prices[i]);
+    mapData.Notify(Map::Change(Map::Change::TRADE_CHANGED, nullptr, commodity));
 }
 
 
@@ -456,11 +540,17 @@ void GalaxyView::mousePressEvent(QMouseEvent *event)
         clickOff = QVector2D(event->pos());
         if(systemView)
         {
+            update(SelectionRect());
             systemView->Select(dragSystem);
+            update(SelectionRect());
             // Update the coloring scheme if coloring by government.
-            if(!government.isEmpty() && !dragSystem->Government().isEmpty())
+            if(!government.isEmpty() && !dragSystem->Government().isEmpty()
+                    && government != dragSystem->Government())
+            {
                 government = dragSystem->Government();
-            update();
+                InvalidateAll();
+                update();
+            }
         }
     }
     else if(event->button() == Qt::RightButton)
@@ -468,8 +558,9 @@ void GalaxyView::mousePressEvent(QMouseEvent *event)
         if(systemView && systemView->Selected())
         {
             systemView->Selected()->ToggleLink(dragSystem);
-            mapData.SetChanged();
-            update();
+            Map::Change change(Map::Change::LINK_TOGGLED, systemView->Selected());
+            change.other = dragSystem;
+            mapData.Notify(change);
         }
         dragSystem = nullptr;
     }
@@ -506,17 +597,25 @@ void GalaxyView::mouseMoveEvent(QMouseEvent *event)
 
     QVector2D distance = QVector2D(event->pos()) - clickOff;
     if(!dragSystem)
+    {
         offset = distance;
+        update();
+    }
     else
     {
         if(dragTime.elapsed() < 1000 && distance.length() < 5.)
             return;
 
+        // Only the area around the system's old and new positions, and the
+        // links to it, need to be redrawn.
+        update(SelectionRect());
+        Map::Change change(Map::Change::SYSTEM_MOVED, dragSystem);
+        change.from = dragSystem->Position();
         dragSystem->SetPosition(dragSystem->Position() + distance / scale);
-        mapData.SetChanged();
+        mapData.Notify(change);
+        update(SelectionRect());
         clickOff = QVector2D(event->pos());
     }
-    update();
 }
 
 
@@ -538,87 +637,51 @@ void GalaxyView::wheelEvent(QWheelEvent *event)
 
 
 
-void GalaxyView::paintEvent(QPaintEvent */*event*/)
+void GalaxyView::paintEvent(QPaintEvent *event)
 {
-    QPen blackPen;
-    QPen mediumPen(QColor(120, 120, 120));
-    QPen brightPen(QColor(180, 180, 180));
-
     QPainter painter(this);
-    painter.setRenderHint(QPainter::Antialiasing, true);
-    painter.setRenderHint(QPainter::SmoothPixmapTransform, true);
-
-    painter.translate(.5 * width(), .5 * height());
-    painter.translate(offset.x(), offset.y());
-    painter.scale(scale, scale);
-
-    // Draw the "galaxy" images.
-    for(const Galaxy &it : mapData.Galaxies())
+    tiles.SetScale(scale);
+    if(!scene || isSceneStale)
+        BuildScene();
+    else if(!staleSystems.empty())
+        UpdateScene();
+
+    QPoint origin = Origin();
+    painter.translate(origin);
+    QRegion region = event->region().translated(-origin);
+    QRectF visible(region.boundingRect());
+    QRect range = TileCache::Range(visible);
+
+    // Wherever a tile has not been rendered yet, show the previous zoom level.
+    QRegion missing;
+    for(int y = range.top(); y <= range.bottom(); ++y)
+        for(int x = range.left(); x <= range.right(); ++x)
+            if(!tiles.Get(x, y) && region.intersects(TileRect(x, y)))
+                missing += TileRect(x, y);
+    if(!missing.isEmpty())
     {
-        QPixmap sprite = SpriteSet::Get(it.Sprite());
-        QPointF pos = (it.Position() - QVector2D(.5 * sprite.width(), .5 * sprite.height())).toPointF();
-        painter.drawPixmap(pos, sprite);
+        painter.setClipRegion(missing);
+        tiles.DrawPrevious(painter, visible);
+        painter.setClipping(false);
     }
 
-    // Draw the links between systems.
-    painter.setBrush(Qt::NoBrush);
-    for(const auto &it : mapData.Systems())
-    {
-        QPointF pos = it.second.Position().toPointF();
-        for(const QString &link : it.second.Links())
+    // Queue up renders of any missing or outdated tiles, and blit the rest.
+    for(int y = range.top(); y <= range.bottom(); ++y)
+        for(int x = range.left(); x <= range.right(); ++x)
         {
-            auto lit = mapData.Systems().find(link);
-            if(lit == mapData.Systems().end())
+            if(!region.intersects(TileRect(x, y)))
                 continue;
-
-            double value = 0.;
-            if(!commodity.isEmpty())
-            {
-                int difference = abs(it.second.Trade(commodity) - lit->second.Trade(commodity));
-                value = (difference - 60) / 60.;
-            }
-            else if(!government.isEmpty())
-                value = (it.second.Government() != lit->second.Government());
-            // Set the link color based on the "value".
-            QPen pen(value < 1. ? MapGrey(value) : QColor(255, 0, 0));
-            painter.setPen(pen);
-            painter.drawLine(pos, lit->second.Position().toPointF());
+            if(tiles.NeedsRender(x, y))
+                pool.start(new TileJob(this, scene, scale, x, y, tiles.Start(x, y)));
+            if(const QImage *image = tiles.Get(x, y))
+                painter.drawImage(QPoint(x * TileCache::SIZE, y * TileCache::SIZE), *image);
         }
-    }
-
-    // Draw the systems, colored by commodity or if the government is the selected government.
-    for(const auto &it : mapData.Systems())
-    {
-        QPointF pos = it.second.Position().toPointF();
-        bool isSelected = (systemView && &it.second == systemView->Selected());
-        double value = 0.;
-        if(!commodity.isEmpty())
-            value = mapData.MapPrice(commodity, it.second.Trade(commodity)) * 2. - 1.;
-        else if(!government.isEmpty())
-            value = (it.second.Government() == government);
-        // Set the link color based on the "value".
-        QColor color = MapColor(value);
-        if(isSelected)
-            color.setRgbF(color.redF() * 1.5, color.greenF() * 1.5, color.blueF() * 1.5);
-        QBrush brush(color);
-        painter.setBrush(brush);
-        painter.setPen(blackPen);
-        painter.drawEllipse(pos, 5, 5);
-
-        painter.drawText(pos + QPointF(6, 6), it.first);
-        painter.setPen(brightPen);
-        painter.drawText(pos + QPointF(5, 5), it.first);
-    }
+    QPoint center = range.center();
+    tiles.Prune(center.x(), center.y(), max(MAX_TILES, 2 * range.width() * range.height()));
 
-    // Draw the selection circle and neighbor radius ring.
-    painter.setPen(mediumPen);
-    painter.setBrush(Qt::NoBrush);
-    if(systemView && systemView->Selected())
-    {
-        QPointF pos = systemView->Selected()->Position().toPointF();
-        painter.drawEllipse(pos, 10, 10);
-        painter.drawEllipse(pos, 100, 100);
-    }
+    painter.setRenderHint(QPainter::Antialiasing, true);
+    painter.scale(scale, scale);
+    DrawOverlay(painter);
 }
 
 
@@ -658,10 +721,367 @@ void GalaxyView::CreateSystem(const QVector2D &origin)
             else
                 for(const Map::Commodity &commodity : mapData.Commodities())
                     system.SetTrade(commodity.name, (commodity.low + commodity.high) / 2);
+            update(SelectionRect());
             if(systemView)
                 systemView->Select(&system);
-            mapData.SetChanged();
+            update(SelectionRect());
+            mapData.Notify(Map::Change(Map::Change::SYSTEM_ADDED, &system));
+        }
+    }
+}
+
+
+
+void GalaxyView::MapChanged(const Map::Change &change)
+{
+    const System *system = change.system;
+    switch(change.type)
+    {
+    case Map::Change::LOADED:
+        labelBounds.clear();
+        InvalidateAll();
+        update();
+        break;
+    case Map::Change::SYSTEM_ADDED:
+    case Map::Change::SYSTEM_REMOVED:
+        InvalidateSystem(*system, system->Position());
+        break;
+    case Map::Change::SYSTEM_MOVED:
+        InvalidateSystem(*system, change.from);
+        InvalidateSystem(*system, system->Position());
+        break;
+    case Map::Change::SYSTEM_RENAMED:
+        // Clear the old name, then draw the new one. Other labels that the
+        // old name was hiding are found when the scene is updated.
+        Invalidate(LabelBounds(change.name).translated(system->Position().toPointF()));
+        staleSystems.emplace_back(change.name, system->Position().toPointF());
+        labelBounds.erase(change.name);
+        GalaxyScene::InvalidateLabels();
+        InvalidateSystem(*system, system->Position());
+        break;
+    case Map::Change::LINK_TOGGLED:
+        InvalidateLink(system->Position(), change.other->Position());
+        staleSystems.emplace_back(system->Name(), system->Position().toPointF());
+        staleSystems.emplace_back(change.other->Name(), change.other->Position().toPointF());
+        break;
+    case Map::Change::TRADE_CHANGED:
+        // Prices only matter if the map is colored by that commodity.
+        if(commodity.isEmpty() || (!change.name.isEmpty() && change.name != commodity))
+            break;
+        if(system)
+            InvalidateSystem(*system, system->Position());
+        else
+        {
+            InvalidateAll();
             update();
         }
+        break;
+    case Map::Change::GOVERNMENT_CHANGED:
+        if(!government.isEmpty())
+            InvalidateSystem(*system, system->Position());
+        break;
+    default:
+        // Nothing else is shown on the galaxy map.
+        break;
+    }
+}
+
+
+
+// Discard the cached tiles that show the given system, its name, or its
+// links, as if the system were at the given position. The scene is updated
+// to match the system as it is now.
+void GalaxyView::InvalidateSystem(const System &system, const QVector2D &position)
+{
+    const QPointF pos = position.toPointF();
+    staleSystems.emplace_back(system.Name(), pos);
+    const double pad = max(12., GalaxyScene::DOT_SIZE / scale);
+    Invalidate(QRectF(pos.x() - pad, pos.y() - pad, 2. * pad, 2. * pad));
+    Invalidate(LabelBounds(system.Name()).translated(pos).adjusted(-2., -2., 2., 2.));
+
+    for(const QString &link : system.Links())
+    {
+        auto it = mapData.Systems().find(link);
+        if(it != mapData.Systems().end())
+            InvalidateLink(position, it->second.Position());
+    }
+}
+
+
+
+// Discard the cached tiles that a link between the given points passes through.
+void GalaxyView::InvalidateLink(const QVector2D &from, const QVector2D &to)
+{
+    // Split long links into pieces, so that a diagonal link does not
+    // invalidate everything in its bounding box.
+    int pieces = max(1, static_cast<int>(ceil(from.distanceToPoint(to) * scale / LINK_PIECE)));
+    for(int i = 0; i < pieces; ++i)
+    {
+        QPointF start = (from + (to - from) * (static_cast<float>(i) / pieces)).toPointF();
+        QPointF end = (from + (to - from) * (static_cast<float>(i + 1) / pieces)).toPointF();
+        Invalidate(QRectF(start, end).normalized().adjusted(-2., -2., 2., 2.));
+    }
+}
+
+
+
+// Discard all the cached tiles, e.g. because the map coloring changed.
+void GalaxyView::InvalidateAll()
+{
+    tiles.Clear();
+    isSceneStale = true;
+    staleSystems.clear();
+}
+
+
+
+// Discard the cached tiles overlapping the given rectangle (in map
+// coordinates), and schedule that part of the view to be redrawn.
+void GalaxyView::Invalidate(const QRectF &bounds)
+{
+    tiles.Invalidate(bounds);
+    update(ScreenRect(bounds));
+}
+
+
+
+// Get the color to draw the given system in.
+QColor GalaxyView::SystemColor(const System &system, bool isSelected) const
+{
+    double value = 0.;
+    if(!commodity.isEmpty())
+        value = mapData.MapPrice(commodity, system.Trade(commodity)) * 2. - 1.;
+    else if(!government.isEmpty())
+        value = (system.Government() == government);
+    // Set the system color based on the "value".
+    QColor color = MapColor(value);
+    if(isSelected)
+        color.setRgbF(color.redF() * 1.5, color.greenF() * 1.5, color.blueF() * 1.5);
+    return color;
+}
+
+
+
+// Get the color to draw the link between the given systems in.
+QColor GalaxyView::LinkColor(const System &from, const System &to) const
+{
+    double value = 0.;
+    if(!commodity.isEmpty())
+    {
+        int difference = abs(from.Trade(commodity) - to.Trade(commodity));
+        value = (difference - 60) / 60.;
+    }
+    else if(!government.isEmpty())
+        value = (from.Government() != to.Government());
+    // Set the link color based on the "value".
+    return (value < 1. ? MapGrey(value) : QColor(255, 0, 0));
+}
+
+
+
+// Take a snapshot of the map's static content, for the tile renderers to use.
+void GalaxyView::BuildScene()
+{
+    shared_ptr<GalaxyScene> newScene(new GalaxyScene);
+    newScene->SetFont(font(), logicalDpiX(), logicalDpiY());
+
+    // The galaxy images are converted once, since they are large. Any that
+    // are still loading are added when they arrive (see SpriteLoaded()).
+    for(const Galaxy &it : mapData.Galaxies())
+    {
+        vector<QImage> &levels = galaxyImages[it.Sprite()];
+        if(levels.empty() && !SpriteSet::Get(it.Sprite()).isNull())
+            for(int level = 0; level < SpriteSet::LEVELS; ++level)
+                levels.push_back(SpriteSet::Get(it.Sprite(), pow(.5, level)).toImage());
+        newScene->AddImage(levels, it.Position().toPointF());
+    }
+
+    for(const auto &it : mapData.Systems())
+        for(const QString &link : it.second.Links())
+        {
+            auto lit = mapData.Systems().find(link);
+            if(lit == mapData.Systems().end())
+                continue;
+            // A two-way link is drawn only from the system whose name sorts first.
+            if(link < it.first && lit->second.Links().count(it.first))
+                continue;
+
+            newScene->AddLink(it.first, it.second.Position().toPointF(), link, lit->second.Position().toPointF(),
+                LinkColor(it.second, lit->second));
+        }
+
+    for(const auto &it : mapData.Systems())
+        newScene->AddSystem(it.second.Position().toPointF(), SystemColor(it.second, false), it.first,
+            LabelBounds(it.first));
+    newScene->PlaceLabels();
+
+    scene = newScene;
+    isSceneStale = false;
+    staleSystems.clear();
+}
+
+
+
+// Make a copy of the scene with the systems that were edited replaced. The
+// copy shares all of the scene except the parts near those systems, so this
+// takes about as long no matter how big the map is.
+void GalaxyView::UpdateScene()
+{
+    shared_ptr<GalaxyScene> newScene(new GalaxyScene(*scene));
+
+    // Remove each system from wherever the scene has it, along with its links.
+    set<QString> names;
+    set<QString> linked;
+    for(const auto &it : staleSystems)
+    {
+        newScene->RemoveSystem(it.first, it.second, linked);
+        names.insert(it.first);
+    }
+    staleSystems.clear();
+
+    // Add back the systems that still exist, and all the links to and from
+    // them. A link is found from either of its ends, so it may be found twice.
+    set<pair<QString, QString>> links;
+    auto addLink = [&links](const QString &from, const QString &to)
+    {
+        links.insert(from < to ? make_pair(from, to) : make_pair(to, from));
+    };
+    for(const QString &name : names)
+    {
+        auto it = mapData.Systems().find(name);
+        if(it == mapData.Systems().end())
+            continue;
+
+        newScene->AddSystem(it->second.Position().toPointF(), SystemColor(it->second, false), name,
+            LabelBounds(name));
+        for(const QString &link : it->second.Links())
+            addLink(name, link);
+    }
+    for(const QString &name : linked)
+    {
+        auto it = mapData.Systems().find(name);
+        if(it != mapData.Systems().end())
+            for(const QString &link : it->second.Links())
+                if(names.count(link))
+                    addLink(name, link);
+    }
+    for(const auto &it : links)
+    {
+        auto from = mapData.Systems().find(it.first);
+        auto to = mapData.Systems().find(it.second);
+        if(from != mapData.Systems().end() && to != mapData.Systems().end())
+            newScene->AddLink(it.first, from->second.Position().toPointF(), it.second,
+                to->second.Position().toPointF(), LinkColor(from->second, to->second));
+    }
+
+    for(const QRectF &bounds : newScene->PlaceLabels())
+    {
+        tiles.Invalidate(bounds.adjusted(-2., -2., 2., 2.));
+        update(ScreenRect(bounds));
+    }
+    scene = newScene;
+}
+
+
+
+// Get the bounds of the given system's label, relative to the system, in map
+// coordinates. The label's text is measured only once.
+const QRectF &GalaxyView::LabelBounds(const QString &name)
+{
+    auto it = labelBounds.find(name);
+    if(it == labelBounds.end())
+        it = labelBounds.emplace(name, GalaxyScene::LabelBounds(font(), this, name)).first;
+    return it->second;
+}
+
+
+
+// Draw everything that depends on the selection.
+void GalaxyView::DrawOverlay(QPainter &painter) const
+{
+    if(!systemView || !systemView->Selected())
+        return;
+
+    const System &selected = *systemView->Selected();
+    QPointF pos = selected.Position().toPointF();
+
+    // Redraw the selected system in a brighter color.
+    if(scale < GalaxyScene::DOT_SCALE)
+        painter.fillRect(GalaxyScene::DotRect(pos, scale), SystemColor(selected, true));
+    else
+    {
+        painter.setPen(QPen());
+        painter.setBrush(QBrush(SystemColor(selected, true)));
+        painter.drawEllipse(pos, 5, 5);
     }
+
+    // Draw the selection circle and neighbor radius ring.
+    painter.setPen(QPen(QColor(120, 120, 120)));
+    painter.setBrush(Qt::NoBrush);
+    painter.drawEllipse(pos, 10, 10);
+    painter.drawEllipse(pos, 100, 100);
+}
+
+
+
+// The tiles are drawn at whole-pixel positions, so the live overlay must
+// use the same rounded origin to line up with them.
+QPoint GalaxyView::Origin() const
+{
+    return (QVector2D(.5 * width(), .5 * height()) + offset).toPoint();
+}
+
+
+
+// Get the rectangle covered by the given tile, relative to the origin.
+QRect GalaxyView::TileRect(int x, int y) const
+{
+    return QRect(x * TileCache::SIZE, y * TileCache::SIZE, TileCache::SIZE, TileCache::SIZE);
+}
+
+
+
+// Get the screen area covering the given rectangle (in map coordinates).
+QRect GalaxyView::ScreenRect(const QRectF &bounds) const
+{
+    QRectF scaled(bounds.topLeft() * scale, bounds.bottomRight() * scale);
+    return scaled.normalized().translated(Origin()).toAlignedRect().adjusted(-1, -1, 1, 1);
+}
+
+
+
+// Get the screen area covered by the selection circles, which are drawn live.
+QRect GalaxyView::SelectionRect() const
+{
+    if(!systemView || !systemView->Selected())
+        return QRect();
+
+    QPointF pos = systemView->Selected()->Position().toPointF();
+    return ScreenRect(QRectF(pos - QPointF(102., 102.), pos + QPointF(102., 102.)));
+}
+
+
+
+// Receive a tile rendered by a worker thread.
+void GalaxyView::TileFinished(int x, int y, double scale, int version, const QImage &image)
+{
+    if(scale != tiles.Scale())
+        return;
+
+    tiles.Finish(x, y, version, image);
+    update(TileRect(x, y).translated(Origin()));
+}
+
+
+
+// If a galaxy image finished loading, redraw everything behind the systems.
+void GalaxyView::SpriteLoaded(const QString &name)
+{
+    for(const Galaxy &it : mapData.Galaxies())
+        if(it.Sprite() == name)
+        {
+            InvalidateAll();
+            update();
+            return;
+        }
 }
@@ -13,16 +13,32 @@ PARTICULAR PURPOSE.  See the GNU General Public License for more details.
 #ifndef GALAXYVIEW_H
 #define GALAXYVIEW_H
 
+#include "Map.h"
+#include "TileCache.h"
+
 #include <QWidget>
 
+#include <QColor>
+#include <QImage>
+#include <QPointF>
+#include <QRectF>
+#include <QString>
 #include <QVector2D>
 #include <QElapsedTimer>
+#include <QThreadPool>
+
+#include <map>
+#include <memory>
+#include <utility>
+#include <vector>
 
+class CommodityRandomizer;
 class DetailView;
-class Map;
+class GalaxyScene;
 class System;
 class SystemView;
 
+class QPainter;
 class QPoint;
 class QTabWidget;
 
@@ -32,6 +48,7 @@ class GalaxyView : public QWidget
     Q_OBJECT
 public:
     explicit GalaxyView(Map &mapData, QTabWidget *tabs, QWidget *parent = 0);
+    ~GalaxyView();
 
     void Center();
     void SetSystemView(SystemView *view);
@@ -48,6 +65,14 @@ public slots:
     void DeleteSystem();
     void Recenter();
     void RandomizeCommodity();
+    void RandomizeCommodityNearby();
+    void RandomizeCommodityInGovernment();
+    void RandomizeAllCommodities();
+    void GenerateSystems();
+
+private slots:
+    void TileFinished(int x, int y, double scale, int version, const QImage &image);
+    void SpriteLoaded(const QString &name);
 
 protected:
     virtual void mousePressEvent(QMouseEvent *event) override;
@@ -60,6 +85,25 @@ protected:
 private:
     QVector2D MapPoint(QPoint pos) const;
     void CreateSystem(const QVector2D &origin);
+    // Give the randomizer's systems new prices for the selected commodity.
+    void RandomizeCommodity(const CommodityRandomizer &randomizer);
+    // Discard the cached rendering of whatever the given map edit affected.
+    void MapChanged(const Map::Change &change);
+    void InvalidateSystem(const System &system, const QVector2D &position);
+    void InvalidateLink(const QVector2D &from, const QVector2D &to);
+    void InvalidateAll();
+    void Invalidate(const QRectF &bounds);
+
+    QColor SystemColor(const System &system, bool isSelected) const;
+    QColor LinkColor(const System &from, const System &to) const;
+    void BuildScene();
+    void UpdateScene();
+    const QRectF &LabelBounds(const QString &name);
+    void DrawOverlay(QPainter &painter) const;
+    QPoint Origin() const;
+    QRect TileRect(int x, int y) const;
+    QRect ScreenRect(const QRectF &bounds) const;
+    QRect SelectionRect() const;
 
 
 private:
@@ -80,6 +124,19 @@ private:
     // Color systems by:
     QString commodity;
     QString government;
+
+    // Pre-rendered galaxy images, links, systems, and labels. The tiles are
+    // rendered by the thread pool from a snapshot of the map, which is
+    // replaced whenever the map changes. After most edits only the systems
+    // that changed are replaced, given their names and the positions that the
+    // scene has them at.
+    TileCache tiles;
+    std::shared_ptr<const GalaxyScene> scene;
+    bool isSceneStale = false;
+    std::vector<std::pair<QString, QPointF>> staleSystems;
+    std::map<QString, std::vector<QImage>> galaxyImages;
+    std::map<QString, QRectF> labelBounds;
+    QThreadPool pool;
 };
 
 
@@ -16,28 +16,124 @@ PARTICULAR PURPOSE.  See the GNU General Public License for more details.
 
 #include <QDir>
 #include <QDirIterator>
+#include <QFileInfo>
+#include <QImageReader>
+#include <QMutex>
+#include <QMutexLocker>
+#include <QRunnable>
+#include <QSize>
+#include <QThread>
+
+#include <algorithm>
+#include <atomic>
 
 using namespace std;
 
+namespace {
+    // Check for new thumbnails this often (in milliseconds), and take at
+    // most this many of them each time, so that the GUI thread is never busy
+    // with them for long.
+    const int DELIVERY_INTERVAL = 50;
+    const size_t MAX_DELIVERED = 16;
+}
+
+
+
+class LandscapeLoader::Batch {
+public:
+    QString root;
+    // This list does not change once the workers are started. Each worker
+    // claims the next image to decode by incrementing the index.
+    vector<QString> toLoad;
+    atomic<size_t> next;
+    atomic<bool> isCancelled;
+    // Number of images that have not been decoded yet.
+    atomic<size_t> remaining;
+
+    // This mutex controls access to the decoded thumbnails.
+    QMutex mutex;
+    map<QString, QImage> loaded;
+};
+
+
+
+class LandscapeLoader::Job : public QRunnable {
+public:
+    explicit Job(const shared_ptr<Batch> &batch) : batch(batch) {}
+
+    virtual void run() override
+    {
+        while(!batch->isCancelled)
+        {
+            size_t index = batch->next++;
+            if(index >= batch->toLoad.size())
+                return;
+            const QString &name = batch->toLoad[index];
+
+            // Have the decoder produce the thumbnail directly. For a JPEG, this
+            // skips most of the work of decoding the full-size image.
+            QImageReader reader(batch->root + name + ".jpg");
+            QSize size = reader.size();
+            if(size.isValid())
+            {
+                size.scale(THUMB_WIDTH, THUMB_HEIGHT, Qt::KeepAspectRatio);
+                reader.setScaledSize(size);
+            }
+            QImage image = reader.read();
+
+            QMutexLocker lock(&batch->mutex);
+            batch->loaded[name] = image;
+            --batch->remaining;
+        }
+    }
+
+
+private:
+    shared_ptr<Batch> batch;
+};
+
 
 
 LandscapeLoader::LandscapeLoader(QObject *parent) :
-    QThread(parent)
+    QObject(parent)
+{
+    pool.setMaxThreadCount(max(1, QThread::idealThreadCount()));
+    timer.setInterval(DELIVERY_INTERVAL);
+    connect(&timer, SIGNAL(timeout()), this, SLOT(Deliver()));
+}
+
+
+
+LandscapeLoader::~LandscapeLoader()
 {
+    // Stop the workers after the images they are decoding now.
+    if(batch)
+        batch->isCancelled = true;
+    pool.waitForDone();
 }
 
 
 
 void LandscapeLoader::Init()
 {
-    // If this is not the first object to initialize this thread, there is
+    // If this is not the first object to initialize the loader, there is
     // no need to do any work. Note that new objects will always be created
     // in the GUI thread, so no synchronization is needed here.
     if(initCount++)
         return;
 
-    // The thread is not started yet, so no mutex is needed.
-    QDir dir(SpriteSet::RootPath() + "land/");
+    available.clear();
+    images.clear();
+    thumbnails.clear();
+    cache.Load();
+
+    batch.reset(new Batch);
+    batch->root = SpriteSet::RootPath();
+    batch->next = 0;
+    batch->isCancelled = false;
+
+    // Only the images that are not in the thumbnail cache need to be decoded.
+    QDir dir(batch->root + "land/");
     QDirIterator it(dir);
     while(it.hasNext())
     {
@@ -47,24 +143,21 @@ void LandscapeLoader::Init()
 
         QString name = "land/" + it.fileName();
         name.chop(4);
-        toLoad.push_back(name);
+        QImage thumbnail = cache.Get(it.fileInfo());
+        if(!thumbnail.isNull())
+            AddThumbnail(name, thumbnail);
+        else
+            batch->toLoad.push_back(name);
     }
-    toLoad.sort();
-
-    start();
-}
-
+    sort(batch->toLoad.begin(), batch->toLoad.end());
+    batch->remaining = batch->toLoad.size();
 
-
-void LandscapeLoader::Update()
-{
-    QMutexLocker lock(&mutex);
-    for(const auto &it : loaded)
-    {
-        available.push_back(it.first);
-        SpriteSet::Set(it.first, it.second);
-    }
-    loaded.clear();
+    int workers = min<int>(pool.maxThreadCount(), batch->toLoad.size());
+    for(int i = 0; i < workers; ++i)
+        pool.start(new Job(batch));
+    if(workers)
+        timer.start();
+    emit Added();
 }
 
 
@@ -75,12 +168,17 @@ void LandscapeLoader::Quit()
     if(--initCount)
         return;
 
-    // Signal the worker that it should quit, even if it had work left to do.
+    // Tell the workers to stop, but do not wait for the images they are
+    // decoding now. They only hold on to the batch, not to this object.
+    timer.stop();
+    if(batch)
     {
-        QMutexLocker lock(&mutex);
-        toLoad.clear();
+        batch->isCancelled = true;
+        // Keep whatever thumbnails were made for the next session.
+        AddLoaded(batch->toLoad.size());
+        batch.reset();
     }
-    wait();
+    cache.Save();
 }
 
 
@@ -92,24 +190,75 @@ const vector<QString> &LandscapeLoader::Available() const
 
 
 
-void LandscapeLoader::run()
+QPixmap LandscapeLoader::Thumbnail(const QString &name) const
+{
+    auto it = thumbnails.find(name);
+    if(it != thumbnails.end())
+        return it->second;
+
+    auto iit = images.find(name);
+    if(iit == images.end())
+        return QPixmap();
+    return thumbnails[name] = QPixmap::fromImage(iit->second);
+}
+
+
+
+void LandscapeLoader::Deliver()
 {
-    while(true)
+    if(!batch)
     {
-        QString nextPath;
-        {
-            QMutexLocker lock(&mutex);
-            if(toLoad.empty())
-                return;
-            nextPath = toLoad.front();
-            toLoad.pop_front();
-        }
+        timer.stop();
+        return;
+    }
+
+    if(AddLoaded(MAX_DELIVERED))
+        emit Added();
+
+    // Once everything is decoded and delivered, there is nothing left to check.
+    bool isDone = false;
+    {
+        QMutexLocker lock(&batch->mutex);
+        isDone = (!batch->remaining && batch->loaded.empty());
+    }
+    if(isDone)
+    {
+        timer.stop();
+        // Save now, in case the editor does not exit cleanly.
+        cache.Save();
+    }
+}
+
 
-        QImage image(SpriteSet::RootPath() + nextPath + ".jpg");
 
+size_t LandscapeLoader::AddLoaded(size_t limit)
+{
+    map<QString, QImage> loaded;
+    {
+        QMutexLocker lock(&batch->mutex);
+        while(!batch->loaded.empty() && loaded.size() < limit)
         {
-            QMutexLocker lock(&mutex);
-            loaded[nextPath] = image;
+            auto it = batch->loaded.begin();
+            loaded.insert(*it);
+            batch->loaded.erase(it);
         }
     }
+    for(const auto &it : loaded)
+    {
+        cache.Set(QFileInfo(batch->root + it.first + ".jpg"), it.second);
+        AddThumbnail(it.first, it.second);
+    }
+    return loaded.size();
+}
+
+
+
+// Add a thumbnail to the gallery, keeping the gallery in sorted order.
+void LandscapeLoader::AddThumbnail(const QString &name, const QImage &image)
+{
+    images[name] = image;
+    thumbnails.erase(name);
+    auto it = lower_bound(available.begin(), available.end(), name);
+    if(it == available.end() || *it != name)
+        available.insert(it, name);
 }
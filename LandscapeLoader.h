@@ -13,47 +13,80 @@ PARTICULAR PURPOSE.  See the GNU General Public License for more details.
 #ifndef LANDSCAPELOADER_H
 #define LANDSCAPELOADER_H
 
-#include <QThread>
+#include "ThumbnailCache.h"
+
+#include <QObject>
 
 #include <QImage>
-#include <QMutex>
+#include <QPixmap>
 #include <QString>
+#include <QThreadPool>
+#include <QTimer>
 
-#include <list>
 #include <map>
+#include <memory>
 #include <vector>
 
 
 
-class LandscapeLoader : public QThread
+// Class that finds all the landscape images, and makes thumbnails of them for
+// the landscape gallery. Thumbnails are kept in a ThumbnailCache between
+// sessions; only new or modified images are decoded, by a pool of threads.
+// New thumbnails are handed to the GUI thread a few at a time, and Added() is
+// emitted whenever the gallery grows. Thumbnails are only converted to pixmaps
+// once they are about to be drawn.
+class LandscapeLoader : public QObject
 {
     Q_OBJECT
+public:
+    // Size of the gallery thumbnails.
+    static const int THUMB_WIDTH = 40;
+    static const int THUMB_HEIGHT = 20;
+
+
 public:
     explicit LandscapeLoader(QObject *parent = 0);
+    ~LandscapeLoader();
 
     void Init();
-    void Update();
     void Quit();
 
+    // Get the names of all the landscapes with thumbnails, in sorted order.
     const std::vector<QString> &Available() const;
+    QPixmap Thumbnail(const QString &name) const;
 
 
 signals:
+    void Added();
 
 public slots:
 
-protected:
-    virtual void run() override;
+private slots:
+    void Deliver();
+
+private:
+    // Move up to the given number of decoded thumbnails into the gallery, and
+    // return how many were moved.
+    size_t AddLoaded(size_t limit);
+    void AddThumbnail(const QString &name, const QImage &image);
+
 
 private:
-    // This mutex controls access to the following:
-    QMutex mutex;
-    std::list<QString> toLoad;
-    std::map<QString, QImage> loaded;
+    // The images to decode, and the results, shared with the worker threads.
+    // Each call to Init() starts a new batch, so threads that are still
+    // finishing a cancelled batch never touch the current one.
+    class Batch;
+    class Job;
+
+    std::shared_ptr<Batch> batch;
+    QThreadPool pool;
+    QTimer timer;
     int initCount = 0;
 
-    // This object does not require mutex access:
     std::vector<QString> available;
+    std::map<QString, QImage> images;
+    mutable std::map<QString, QPixmap> thumbnails;
+    ThumbnailCache cache;
 };
 
 
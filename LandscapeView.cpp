@@ -12,29 +12,30 @@ PARTICULAR PURPOSE.  See the GNU General Public License for more details.
 
 #include "LandscapeView.h"
 
-#include "LandscapeLoader.h"
 #include "Map.h"
 #include "Planet.h"
+#include "SpriteQueue.h"
 #include "SpriteSet.h"
 
 #include <QImage>
+#include <QKeyEvent>
 #include <QMouseEvent>
-#include <QMutex>
 #include <QPainter>
-#include <QThread>
+#include <QTimer>
+#include <QWheelEvent>
 
 #include <algorithm>
-#include <list>
+#include <utility>
+#include <vector>
 
 using namespace std;
 
 namespace {
-    LandscapeLoader loader;
-
-    static const int THUMB_SCALE = 18;
     static const int THUMB_PAD = 2;
-    static const int thumbWidth = (720 / THUMB_SCALE) + 2 * THUMB_PAD;
-    static const int thumbHeight = (360 / THUMB_SCALE) + 2 * THUMB_PAD;
+    static const int thumbWidth = LandscapeLoader::THUMB_WIDTH + 2 * THUMB_PAD;
+    static const int thumbHeight = LandscapeLoader::THUMB_HEIGHT + 2 * THUMB_PAD;
+
+    static const QString PREFIX = "land/";
 }
 
 
@@ -42,7 +43,12 @@ namespace {
 LandscapeView::LandscapeView(const Map &mapData, QWidget *parent) :
     QWidget(parent), mapData(mapData)
 {
+    // Clicking on the gallery lets you type in it to filter it.
+    setFocusPolicy(Qt::ClickFocus);
     loader.Init();
+    connect(&loader, SIGNAL(Added()), this, SLOT(update()));
+    // The selected landscape may be loaded in the background.
+    connect(&SpriteQueue::Instance(), SIGNAL(Loaded(const QString &)), this, SLOT(update()));
 }
 
 
@@ -79,21 +85,48 @@ const QString &LandscapeView::Landscape() const
 
 
 
+// While the gallery is shown, typing filters it by file name.
+void LandscapeView::keyPressEvent(QKeyEvent *event)
+{
+    if(!showGallery)
+    {
+        QWidget::keyPressEvent(event);
+        return;
+    }
+
+    if(event->key() == Qt::Key_Backspace)
+        filter.chop(1);
+    else if(event->key() == Qt::Key_Escape)
+        filter.clear();
+    else if(!event->text().isEmpty() && event->text()[0].isPrint())
+        filter += event->text();
+    else
+    {
+        QWidget::keyPressEvent(event);
+        return;
+    }
+    firstRow = 0;
+    update();
+}
+
+
+
 void LandscapeView::mousePressEvent(QMouseEvent *event)
 {
     showGallery = !showGallery;
     if(!showGallery)
     {
-        int cols = width() / thumbWidth;
-        int rows = height() / thumbHeight;
+        int cols = Columns();
+        int rows = Rows();
         int left = (width() - cols * thumbWidth) / 2;
         int top = (height() - rows * thumbHeight) / 2;
         int x = event->pos().x() - left;
         int y = event->pos().y() - top;
         if(x >= 0 && x < cols * thumbWidth && y >= 0 && y < rows * thumbHeight)
         {
-            unsigned index = x / thumbWidth + cols * (y / thumbHeight);
-            if(index < loader.Available().size())
+            pair<size_t, size_t> matches = Matches();
+            size_t index = matches.first + x / thumbWidth + cols * (firstRow + y / thumbHeight);
+            if(index < matches.second)
             {
                 SetLandscape(loader.Available()[index]);
                 if(planet)
@@ -106,10 +139,20 @@ void LandscapeView::mousePressEvent(QMouseEvent *event)
 
 
 
-void LandscapeView::paintEvent(QPaintEvent */*event*/)
+// Scroll the gallery by one row for each step of the wheel.
+void LandscapeView::wheelEvent(QWheelEvent *event)
 {
-    loader.Update();
+    if(!showGallery)
+        return;
+
+    ScrollTo(firstRow - event->delta() / 120);
+    update();
+}
+
 
+
+void LandscapeView::paintEvent(QPaintEvent */*event*/)
+{
     QPainter painter(this);
     painter.setRenderHint(QPainter::SmoothPixmapTransform, true);
 
@@ -128,25 +171,93 @@ void LandscapeView::paintEvent(QPaintEvent */*event*/)
         return;
     }
 
-    int cols = width() / thumbWidth;
-    int rows = height() / thumbHeight;
+    // The gallery may have shrunk (e.g. because the filter changed) since it
+    // was scrolled.
+    ScrollTo(firstRow);
+    int cols = Columns();
+    int rows = Rows();
     int left = (width() - cols * thumbWidth) / 2;
     int top = (height() - rows * thumbHeight) / 2;
 
-    auto it = loader.Available().begin();
-    auto end = loader.Available().end();
-    for(int row = 0; row < rows && it != end; ++row)
-        for(int col = 0; col < cols && it != end; ++col, ++it)
+    // Only visit the thumbnails that are on screen.
+    pair<size_t, size_t> matches = Matches();
+    size_t index = matches.first + static_cast<size_t>(firstRow) * cols;
+    for(int row = 0; row < rows && index < matches.second; ++row)
+        for(int col = 0; col < cols && index < matches.second; ++col, ++index)
         {
-            QPixmap image = SpriteSet::Get(*it);
             int x = left + col * thumbWidth + THUMB_PAD;
             int y = top + row * thumbHeight + THUMB_PAD;
-            painter.translate(x, y);
-            painter.scale(1. / THUMB_SCALE, 1. / THUMB_SCALE);
-            painter.drawPixmap(QPoint(), image);
-            painter.scale(THUMB_SCALE, THUMB_SCALE);
-            painter.translate(-x, -y);
+            painter.drawPixmap(x, y, loader.Thumbnail(loader.Available()[index]));
         }
+
+    if(!filter.isEmpty())
+    {
+        painter.setPen(Qt::white);
+        painter.drawText(rect().adjusted(4, 4, -4, -4), Qt::AlignLeft | Qt::AlignBottom, "Filter: " + filter);
+    }
+
+    // Once this paint is done, get the next screen ready.
+    if(!isPrefetchQueued && index < matches.second)
+    {
+        isPrefetchQueued = true;
+        QTimer::singleShot(0, this, SLOT(Prefetch()));
+    }
+}
+
+
+
+// Convert the thumbnails one screen below the visible ones, so that they are
+// ready to draw if the gallery is scrolled.
+void LandscapeView::Prefetch()
+{
+    isPrefetchQueued = false;
+    if(!showGallery)
+        return;
+
+    pair<size_t, size_t> matches = Matches();
+    size_t index = matches.first + static_cast<size_t>(firstRow + Rows()) * Columns();
+    size_t end = min(matches.second, index + static_cast<size_t>(Rows()) * Columns());
+    for( ; index < end; ++index)
+        loader.Thumbnail(loader.Available()[index]);
+}
+
+
+
+pair<size_t, size_t> LandscapeView::Matches() const
+{
+    // The landscapes are sorted, so all the ones with the given prefix are
+    // next to each other.
+    const vector<QString> &available = loader.Available();
+    QString prefix = PREFIX + filter;
+    auto first = lower_bound(available.begin(), available.end(), prefix);
+    auto last = lower_bound(first, available.end(), prefix,
+        [](const QString &name, const QString &prefix) { return name.startsWith(prefix); });
+    return make_pair(first - available.begin(), last - available.begin());
+}
+
+
+
+int LandscapeView::Columns() const
+{
+    return max(1, width() / thumbWidth);
+}
+
+
+
+int LandscapeView::Rows() const
+{
+    return max(1, height() / thumbHeight);
+}
+
+
+
+// Scroll the gallery so the given row is at the top, without scrolling past
+// the last row.
+void LandscapeView::ScrollTo(int row)
+{
+    pair<size_t, size_t> matches = Matches();
+    int totalRows = (matches.second - matches.first + Columns() - 1) / Columns();
+    firstRow = max(0, min(row, totalRows - Rows()));
 }
 
 
@@ -13,8 +13,14 @@ PARTICULAR PURPOSE.  See the GNU General Public License for more details.
 #ifndef LANDSCAPEVIEW_H
 #define LANDSCAPEVIEW_H
 
+#include "LandscapeLoader.h"
+
 #include <QWidget>
 
+#include <QString>
+
+#include <utility>
+
 class Map;
 class Planet;
 
@@ -35,13 +41,25 @@ signals:
 
 public slots:
 
+private slots:
+    void Prefetch();
+
 protected:
+    virtual void keyPressEvent(QKeyEvent *event) override;
     virtual void mousePressEvent(QMouseEvent *event) override;
+    virtual void wheelEvent(QWheelEvent *event) override;
     virtual void paintEvent(QPaintEvent *event) override;
 
 
 private:
     void SetLandscape(const QString &name);
+    // Get the range of gallery entries that match the filter, as indices into
+    // the loader's list of available landscapes.
+    std::pair<size_t, size_t> Matches() const;
+    // Get the number of thumbnails that fit in each row and column.
+    int Columns() const;
+    int Rows() const;
+    void ScrollTo(int row);
 
 
 private:
@@ -49,6 +67,15 @@ private:
     Planet *planet = nullptr;
     bool showGallery = false;
     QString landscape;
+
+    // Decodes the gallery thumbnails in the background.
+    LandscapeLoader loader;
+
+    // The gallery only shows landscapes whose file names start with the filter,
+    // starting from the given row.
+    QString filter;
+    int firstRow = 0;
+    bool isPrefetchQueued = false;
 };
 
 #endif // LANDSCAPEVIEW_H
@@ -88,7 +88,7 @@ void MainWindow::NewMap()
     if(!path.isEmpty())
     {
         // Create the empty map file.
-        map = Map();
+        map.Clear();
         map.Save(path);
         // Initialize the editor with the empty map.
         DoOpen(path);
@@ -288,6 +288,19 @@ void MainWindow::CreateMenus()
         QAction *randomizeCommodityAction = galaxyMenu->addAction("Randomize Commodity");
         connect(randomizeCommodityAction, SIGNAL(triggered()), galaxyView, SLOT(RandomizeCommodity()));
         randomizeCommodityAction->setShortcut(QKeySequence("C"));
+
+        QAction *randomizeNearbyAction = galaxyMenu->addAction("Randomize Commodity Nearby...");
+        connect(randomizeNearbyAction, SIGNAL(triggered()), galaxyView, SLOT(RandomizeCommodityNearby()));
+
+        QAction *randomizeGovernmentAction = galaxyMenu->addAction("Randomize Commodity in Government");
+        connect(randomizeGovernmentAction, SIGNAL(triggered()), galaxyView, SLOT(RandomizeCommodityInGovernment()));
+
+        QAction *randomizeAllAction = galaxyMenu->addAction("Randomize All Commodities...");
+        connect(randomizeAllAction, SIGNAL(triggered()), galaxyView, SLOT(RandomizeAllCommodities()));
+
+        galaxyMenu->addSeparator();
+        QAction *generateAction = galaxyMenu->addAction("Regenerate Nearby Systems...");
+        connect(generateAction, SIGNAL(triggered()), galaxyView, SLOT(GenerateSystems()));
     }
 
     // System Menu:
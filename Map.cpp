@@ -28,7 +28,7 @@ using namespace std;
 void Map::Load(const QString &path)
 {
     // Clear everything first.
-    *this = Map();
+    Clear();
 
     QFileInfo p = QFileInfo(path);
 
@@ -64,6 +64,7 @@ void Map::Load(const QString &path)
                 if(child.Token(0) == "commodity" && child.Size() >= 4)
                     commodities.emplace_back(child.Token(1), child.Value(2), child.Value(3));
 
+    Notify(Change(Change::LOADED));
     isChanged = false;
 }
 
@@ -117,6 +118,16 @@ const QString &Map::FileName() const
 
 
 
+void Map::Clear()
+{
+    vector<Listener> keep;
+    keep.swap(listeners);
+    *this = Map();
+    listeners.swap(keep);
+}
+
+
+
 void Map::SetChanged(bool changed)
 {
     isChanged = changed;
@@ -131,6 +142,22 @@ bool Map::IsChanged() const
 
 
 
+void Map::AddListener(const Listener &listener)
+{
+    listeners.push_back(listener);
+}
+
+
+
+void Map::Notify(const Change &change)
+{
+    isChanged = true;
+    for(const Listener &listener : listeners)
+        listener(change);
+}
+
+
+
 list<Galaxy> &Map::Galaxies()
 {
     return galaxies;
@@ -17,9 +17,11 @@ PARTICULAR PURPOSE.  See the GNU General Public License for more details.
 #include "Planet.h"
 #include "System.h"
 
+#include <functional>
 #include <list>
 #include <map>
 #include <string>
+#include <vector>
 
 class DataNode;
 class StellarObject;
@@ -27,6 +29,44 @@ class StellarObject;
 
 
 class Map {
+public:
+    // Description of an edit to the map. Listeners use this to update only
+    // the state that the edit actually affects.
+    class Change {
+    public:
+        enum Type {
+            LOADED,
+            SYSTEM_ADDED,
+            SYSTEM_REMOVED,
+            SYSTEM_RENAMED,
+            SYSTEM_MOVED,
+            LINK_TOGGLED,
+            TRADE_CHANGED,
+            GOVERNMENT_CHANGED,
+            OBJECTS_CHANGED,
+            FLEETS_CHANGED,
+            MINABLES_CHANGED,
+            PLANET_RENAMED
+        };
+
+    public:
+        Change(Type type, const System *system = nullptr, const QString &name = QString())
+            : type(type), system(system), name(name) {}
+
+        Type type;
+        // The system that was edited, or null if the edit affected many systems.
+        const System *system;
+        // The commodity whose price changed (or nothing, if all of them did),
+        // or the old name of a renamed system or planet.
+        QString name;
+        // For a link, the system at the other end of it.
+        const System *other = nullptr;
+        // For a move, the position the system was moved from.
+        QVector2D from;
+    };
+    typedef std::function<void(const Change &)> Listener;
+
+
 public:
     // Load from the given file, and remember which file was read from.
     void Load(const QString &path);
@@ -35,10 +75,19 @@ public:
     const QString &DataDirectory() const;
     const QString &FileName() const;
 
+    // Discard all the map data, but keep any registered listeners.
+    void Clear();
+
     // Mark this file as changed.
     void SetChanged(bool changed = true);
     bool IsChanged() const;
 
+    // Register a function to be called after every change to the map.
+    void AddListener(const Listener &listener);
+    // Mark the map as changed and tell every listener what changed. A system
+    // that is about to be removed is reported before it is erased.
+    void Notify(const Change &change);
+
     std::list<Galaxy> &Galaxies();
     const std::list<Galaxy> &Galaxies() const;
 
@@ -77,6 +126,8 @@ private:
     std::list<DataNode> unparsed;
 
     mutable bool isChanged = false;
+
+    std::vector<Listener> listeners;
 };
 
 #endif // MAP_H
@@ -0,0 +1,110 @@
+/* Orbits.cpp
+Copyright (c) 2015 by Michael Zahniser
+
+Endless Sky is free software: you can redistribute it and/or modify it under the
+terms of the GNU General Public License as published by the Free Software
+Foundation, either version 3 of the License, or (at your option) any later version.
+
+Endless Sky is distributed in the hope that it will be useful, but WITHOUT ANY
+WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A
+PARTICULAR PURPOSE.  See the GNU General Public License for more details.
+*/
+
+#include "Orbits.h"
+
+#include "pi.h"
+
+#include <cmath>
+
+using namespace std;
+
+namespace {
+    const double ROUND = 6755399441055744.;
+
+    // Get sin(2 pi * turns). The angle is folded into the quarter turn on
+    // either side of zero, where a short polynomial is accurate to better than
+    // one part in ten million. There are no branches, so a loop calling this
+    // can be vectorized.
+    inline double SinTurns(double turns)
+    {
+        // Reduce to [-1/2, 1/2] by subtracting the nearest whole number. Adding
+        // and subtracting 1.5 * 2^52 rounds to the nearest whole number, and
+        // unlike floor() it can be vectorized without any special compiler
+        // flags. Then use sin(pi - x) = sin(x) to fold the outer quarters onto
+        // the inner ones.
+        turns -= (turns + ROUND) - ROUND;
+        turns = copysign(.25 - fabs(fabs(turns) - .25), turns);
+
+        const double x = 2. * PI * turns;
+        const double x2 = x * x;
+        return x * (1. + x2 * (-1. / 6. + x2 * (1. / 120. + x2 * (-1. / 5040.
+            + x2 * (1. / 362880. + x2 * (-1. / 39916800.))))));
+    }
+}
+
+
+
+void Orbits::Clear()
+{
+    frequency.clear();
+    phase.clear();
+    distance.clear();
+    parent.clear();
+    x.clear();
+    y.clear();
+}
+
+
+
+void Orbits::Add(double distance, double period, double offset, int parent)
+{
+    frequency.push_back(period ? 1. / period : 0.);
+    phase.push_back(offset / 360.);
+    this->distance.push_back(distance);
+    this->parent.push_back(parent);
+    x.push_back(0.);
+    y.push_back(0.);
+}
+
+
+
+size_t Orbits::Size() const
+{
+    return distance.size();
+}
+
+
+
+void Orbits::SetDay(double day)
+{
+    // Work through plain pointers, so the compiler can tell that writing the
+    // positions does not change where the other arrays are.
+    const size_t count = distance.size();
+    const double *frequency = this->frequency.data();
+    const double *phase = this->phase.data();
+    const double *distance = this->distance.data();
+    double *x = this->x.data();
+    double *y = this->y.data();
+    for(size_t i = 0; i < count; ++i)
+    {
+        const double turns = day * frequency[i] + phase[i];
+        x[i] = distance[i] * SinTurns(turns);
+        y[i] = -distance[i] * SinTurns(turns + .25);
+    }
+
+    // Parents always come before their children, so each parent's position is
+    // already final when its children are reached.
+    for(size_t i = 0; i < count; ++i)
+        if(parent[i] >= 0)
+        {
+            x[i] += x[parent[i]];
+            y[i] += y[parent[i]];
+        }
+}
+
+
+
+QVector2D Orbits::Position(size_t index) const
+{
+    return QVector2D(x[index], y[index]);
+}
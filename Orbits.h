@@ -0,0 +1,54 @@
+/* Orbits.h
+Copyright (c) 2015 by Michael Zahniser
+
+Endless Sky is free software: you can redistribute it and/or modify it under the
+terms of the GNU General Public License as published by the Free Software
+Foundation, either version 3 of the License, or (at your option) any later version.
+
+Endless Sky is distributed in the hope that it will be useful, but WITHOUT ANY
+WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A
+PARTICULAR PURPOSE.  See the GNU General Public License for more details.
+*/
+
+#ifndef ORBITS_H_
+#define ORBITS_H_
+
+#include <QVector2D>
+
+#include <vector>
+
+
+
+// Class holding the orbital parameters of the stellar objects in a system, with
+// each parameter in its own array, so that the positions on a given day can be
+// computed in one tight loop that the compiler can vectorize. Objects must be
+// added in the same order as in the system, i.e. each object's parent before
+// the object itself.
+class Orbits {
+public:
+    void Clear();
+    // Add an object. The offset is in degrees, and a period of zero means the
+    // object does not move.
+    void Add(double distance, double period, double offset, int parent);
+    size_t Size() const;
+
+    // Compute the position of every object on the given day.
+    void SetDay(double day);
+    QVector2D Position(size_t index) const;
+
+
+private:
+    // Orbits per day, and the starting angle, both in full turns.
+    std::vector<double> frequency;
+    std::vector<double> phase;
+    std::vector<double> distance;
+    std::vector<int> parent;
+
+    // Positions on the most recently set day.
+    std::vector<double> x;
+    std::vector<double> y;
+};
+
+
+
+#endif
@@ -225,6 +225,7 @@ void PlanetView::NameChanged()
     else
     {
         // Copy the planet data from the old name to the new name..
+        QString oldName = object->GetPlanet();
         mapData.RenamePlanet(object, name->text());
 
         // Update (or create, if not previously a planet) the new name's data.
@@ -242,7 +243,7 @@ void PlanetView::NameChanged()
         if(!security->text().isEmpty())
             planet.SetSecurity(security->text().toDouble());
 
-        mapData.SetChanged();
+        mapData.Notify(Map::Change(Map::Change::PLANET_RENAMED, nullptr, oldName));
     }
 }
 
@@ -0,0 +1,61 @@
+/* Random.cpp
+Copyright (c) 2015 by Michael Zahniser
+
+Endless Sky is free software: you can redistribute it and/or modify it under the
+terms of the GNU General Public License as published by the Free Software
+Foundation, either version 3 of the License, or (at your option) any later version.
+
+Endless Sky is distributed in the hope that it will be useful, but WITHOUT ANY
+WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A
+PARTICULAR PURPOSE.  See the GNU General Public License for more details.
+*/
+
+#include "Random.h"
+
+using namespace std;
+
+
+
+quint64 Random::NewSeed()
+{
+    random_device device;
+    return (static_cast<quint64>(device()) << 32) ^ device();
+}
+
+
+
+Random &Random::Local()
+{
+    static thread_local Random random(NewSeed());
+    return random;
+}
+
+
+
+Random::Random(quint64 seed, quint64 stream)
+{
+    // The standard seed sequence mixes all its inputs together, so nearby
+    // seeds or stream numbers still give very different engine states.
+    seed_seq sequence = {
+        static_cast<quint32>(seed), static_cast<quint32>(seed >> 32),
+        static_cast<quint32>(stream), static_cast<quint32>(stream >> 32)};
+    engine.seed(sequence);
+}
+
+
+
+int Random::Int(int modulus)
+{
+    // The standard distributions may differ between compilers, which would
+    // make a seed give different results on different platforms. The bias
+    // from using a modulus on a 64-bit number is negligible.
+    return modulus > 0 ? static_cast<int>(engine() % static_cast<quint64>(modulus)) : 0;
+}
+
+
+
+double Random::Real()
+{
+    // Use the top 53 bits, which is all that a double can hold.
+    return (engine() >> 11) * (1. / 9007199254740992.);
+}
@@ -0,0 +1,50 @@
+/* Random.h
+Copyright (c) 2015 by Michael Zahniser
+
+Endless Sky is free software: you can redistribute it and/or modify it under the
+terms of the GNU General Public License as published by the Free Software
+Foundation, either version 3 of the License, or (at your option) any later version.
+
+Endless Sky is distributed in the hope that it will be useful, but WITHOUT ANY
+WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A
+PARTICULAR PURPOSE.  See the GNU General Public License for more details.
+*/
+
+#ifndef RANDOM_H
+#define RANDOM_H
+
+#include <QtGlobal>
+
+#include <random>
+
+
+
+// Class representing a stream of random numbers. Unlike rand(), each stream
+// has its own state, so separate threads can each use their own stream, and
+// a stream started from the same seed always gives the same numbers.
+class Random {
+public:
+    // Get a seed that is different every time.
+    static quint64 NewSeed();
+    // Get this thread's own stream. Code that is not handed a stream uses
+    // this one; a job can make its results repeatable by assigning a freshly
+    // seeded stream to it before it starts.
+    static Random &Local();
+
+    // Start a stream from the given seed. Streams with the same seed but a
+    // different stream number are unrelated to each other.
+    explicit Random(quint64 seed, quint64 stream = 0);
+
+    // Get a random integer in the range [0, modulus).
+    int Int(int modulus);
+    // Get a random number in the range [0, 1).
+    double Real();
+
+
+private:
+    std::mt19937_64 engine;
+};
+
+
+
+#endif // RANDOM_H
@@ -0,0 +1,354 @@
+/* SpriteAtlas.cpp
+Copyright (c) 2015 by Michael Zahniser
+
+Endless Sky is free software: you can redistribute it and/or modify it under the
+terms of the GNU General Public License as published by the Free Software
+Foundation, either version 3 of the License, or (at your option) any later version.
+
+Endless Sky is distributed in the hope that it will be useful, but WITHOUT ANY
+WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A
+PARTICULAR PURPOSE.  See the GNU General Public License for more details.
+*/
+
+#include "SpriteAtlas.h"
+
+#include <QApplication>
+#include <QByteArray>
+#include <QCryptographicHash>
+#include <QDataStream>
+#include <QDateTime>
+#include <QDir>
+#include <QDirIterator>
+#include <QFileInfo>
+#include <QImageReader>
+#include <QMetaObject>
+#include <QRunnable>
+#include <QSaveFile>
+#include <QStandardPaths>
+#include <QStringList>
+
+#include <algorithm>
+#include <vector>
+
+using namespace std;
+
+namespace {
+    // The atlas file starts with these, so that a file in some other format
+    // (or an older version of this one) is rebuilt instead of misread.
+    const quint32 MAGIC = 0x45535341;
+    const quint32 VERSION = 1;
+    // Each sprite's pixels start at a multiple of this many bytes.
+    const qint64 ALIGN = 64;
+    // Parts of the images tree that go in the atlas.
+    const QStringList DIRECTORIES = {"star", "planet", "asteroid"};
+    const QStringList FILTERS = {"*.jpg", "*.png"};
+
+    bool isEnabled = false;
+
+    class Source {
+    public:
+        QString name;
+        QString path;
+        qint64 size;
+        qint64 modified;
+    };
+
+    // Each images directory gets its own atlas.
+    QString AtlasPath(const QString &root)
+    {
+        return QStandardPaths::writableLocation(QStandardPaths::CacheLocation)
+            + "/sprites-" + QString::number(qHash(root), 16) + ".atlas";
+    }
+
+    qint64 Align(qint64 offset)
+    {
+        return (offset + ALIGN - 1) / ALIGN * ALIGN;
+    }
+
+    // List the images that go in the atlas, and return a signature of their
+    // names, sizes, and modification times.
+    QByteArray List(const QString &root, vector<Source> &sources)
+    {
+        QDir rootDir(root);
+        for(const QString &directory : DIRECTORIES)
+        {
+            QDirIterator it(root + directory, FILTERS, QDir::Files, QDirIterator::Subdirectories);
+            while(it.hasNext())
+            {
+                it.next();
+                QFileInfo info = it.fileInfo();
+                QString name = rootDir.relativeFilePath(info.filePath());
+                name.chop(info.suffix().length() + 1);
+                sources.push_back({name, info.filePath(), info.size(), info.lastModified().toMSecsSinceEpoch()});
+            }
+        }
+        sort(sources.begin(), sources.end(),
+            [](const Source &a, const Source &b) { return a.name < b.name; });
+
+        QCryptographicHash hash(QCryptographicHash::Sha1);
+        for(const Source &source : sources)
+        {
+            hash.addData(source.name.toUtf8());
+            hash.addData(QByteArray::number(source.size) + ':' + QByteArray::number(source.modified) + '\n');
+        }
+        return hash.result();
+    }
+
+    // Check if the atlas at the given path was built from images with the
+    // given signature.
+    bool IsCurrent(const QString &path, const QByteArray &signature)
+    {
+        QFile file(path);
+        if(!file.open(QIODevice::ReadOnly))
+            return false;
+
+        QDataStream in(&file);
+        in.setVersion(QDataStream::Qt_5_0);
+        quint32 magic = 0;
+        quint32 version = 0;
+        QByteArray existing;
+        in >> magic >> version >> existing;
+        return (magic == MAGIC && version == VERSION && existing == signature);
+    }
+
+    // Decode all the given images, and write them to the given path. The
+    // file is: a header, an index of the sprites, and then each sprite's
+    // premultiplied ARGB pixels. Returns false if the build was cancelled or
+    // the file could not be written.
+    bool Build(const QString &path, const QByteArray &signature, const vector<Source> &sources,
+        const atomic<bool> &cancelled)
+    {
+        // The index is written before the pixels, so the image sizes are read
+        // from the file headers without decoding them.
+        vector<QSize> sizes;
+        QByteArray index;
+        {
+            QDataStream out(&index, QIODevice::WriteOnly);
+            out.setVersion(QDataStream::Qt_5_0);
+            out << static_cast<quint32>(sources.size());
+            qint64 offset = 0;
+            for(const Source &source : sources)
+            {
+                QSize size = QImageReader(source.path).size();
+                if(!size.isValid())
+                    size = QSize(0, 0);
+                sizes.push_back(size);
+                out << source.name << static_cast<qint32>(size.width()) << static_cast<qint32>(size.height())
+                    << static_cast<qint32>(4 * size.width()) << offset;
+                offset = Align(offset + 4 * size.width() * size.height());
+            }
+        }
+
+        QDir().mkpath(QFileInfo(path).absolutePath());
+        QSaveFile file(path);
+        if(!file.open(QIODevice::WriteOnly))
+            return false;
+
+        // Header: magic, version, signature, start of the pixel data, index.
+        const qint64 headerSize = 4 + 4 + 4 + signature.size() + 8 + index.size();
+        const qint64 dataStart = Align(headerSize);
+        {
+            QDataStream out(&file);
+            out.setVersion(QDataStream::Qt_5_0);
+            out << MAGIC << VERSION << signature << dataStart;
+            out.writeRawData(index.constData(), index.size());
+        }
+        file.write(QByteArray(dataStart - headerSize, '\0'));
+
+        for(size_t i = 0; i < sources.size(); ++i)
+        {
+            if(cancelled)
+            {
+                file.cancelWriting();
+                return false;
+            }
+            const QSize &size = sizes[i];
+            QImage image = QImage(sources[i].path).convertToFormat(QImage::Format_ARGB32_Premultiplied);
+            // If the file's header did not match its contents, leave the
+            // sprite blank rather than misplacing everything after it.
+            const int bytesPerLine = 4 * size.width();
+            if(image.size() == size)
+                for(int y = 0; y < size.height(); ++y)
+                    file.write(reinterpret_cast<const char *>(image.constScanLine(y)), bytesPerLine);
+            else
+                file.write(QByteArray(bytesPerLine * size.height(), '\0'));
+
+            qint64 length = static_cast<qint64>(bytesPerLine) * size.height();
+            file.write(QByteArray(Align(length) - length, '\0'));
+        }
+        return file.commit();
+    }
+}
+
+
+
+// Job that checks whether the atlas is current, and rebuilds it if not.
+class SpriteAtlas::BuildJob : public QRunnable {
+public:
+    BuildJob(SpriteAtlas *atlas, const QString &root, const shared_ptr<atomic<bool>> &cancelled)
+        : atlas(atlas), root(root), cancelled(cancelled) {}
+
+    virtual void run() override
+    {
+        vector<Source> sources;
+        QByteArray signature = List(root, sources);
+        QString path = AtlasPath(root);
+        if(!IsCurrent(path, signature) && !Build(path, signature, sources, *cancelled))
+            return;
+
+        if(!*cancelled)
+            QMetaObject::invokeMethod(atlas, "Ready", Qt::QueuedConnection, Q_ARG(QString, root));
+    }
+
+
+private:
+    SpriteAtlas *atlas;
+    QString root;
+    shared_ptr<atomic<bool>> cancelled;
+};
+
+
+
+void SpriteAtlas::Enable()
+{
+    isEnabled = true;
+}
+
+
+
+bool SpriteAtlas::IsEnabled()
+{
+    return isEnabled;
+}
+
+
+
+SpriteAtlas &SpriteAtlas::Instance()
+{
+    static SpriteAtlas *atlas = new SpriteAtlas(qApp);
+    return *atlas;
+}
+
+
+
+SpriteAtlas::SpriteAtlas(QObject *parent) :
+    QObject(parent)
+{
+    // Building the atlas is one long job, which should not hold up the
+    // threads that load sprites in the meantime.
+    pool.setMaxThreadCount(1);
+}
+
+
+
+SpriteAtlas::~SpriteAtlas()
+{
+    if(cancelled)
+        *cancelled = true;
+    pool.waitForDone();
+    Close();
+}
+
+
+
+void SpriteAtlas::SetRoot(const QString &root)
+{
+    if(root == this->root)
+        return;
+
+    // Stop any build for the previous directory, and stop using its atlas.
+    if(cancelled)
+        *cancelled = true;
+    Close();
+
+    this->root = root;
+    if(root.isEmpty())
+        return;
+
+    cancelled.reset(new atomic<bool>(false));
+    pool.start(new BuildJob(this, root, cancelled));
+}
+
+
+
+QImage SpriteAtlas::Get(const QString &name) const
+{
+    auto it = entries.find(name);
+    if(it == entries.end() || !it->width || !it->height)
+        return QImage();
+
+    return QImage(pixels + it->offset, it->width, it->height, it->bytesPerLine,
+        QImage::Format_ARGB32_Premultiplied);
+}
+
+
+
+void SpriteAtlas::Remove(const QString &name)
+{
+    entries.remove(name);
+}
+
+
+
+// The atlas for the given directory is built and up to date. Map it, and
+// read its index.
+void SpriteAtlas::Ready(const QString &root)
+{
+    if(root != this->root || file)
+        return;
+
+    file.reset(new QFile(AtlasPath(root)));
+    if(!file->open(QIODevice::ReadOnly))
+    {
+        file.reset();
+        return;
+    }
+    const qint64 size = file->size();
+    pixels = file->map(0, size);
+    if(!pixels)
+    {
+        Close();
+        return;
+    }
+
+    QDataStream in(file.get());
+    in.setVersion(QDataStream::Qt_5_0);
+    quint32 magic = 0;
+    quint32 version = 0;
+    QByteArray signature;
+    qint64 dataStart = 0;
+    quint32 count = 0;
+    in >> magic >> version >> signature >> dataStart >> count;
+    if(magic != MAGIC || version != VERSION)
+    {
+        Close();
+        return;
+    }
+    for(quint32 i = 0; i < count && in.status() == QDataStream::Ok; ++i)
+    {
+        QString name;
+        qint32 width = 0;
+        qint32 height = 0;
+        qint32 bytesPerLine = 0;
+        Entry entry;
+        in >> name >> width >> height >> bytesPerLine >> entry.offset;
+        entry.width = width;
+        entry.height = height;
+        entry.bytesPerLine = bytesPerLine;
+        entry.offset += dataStart;
+        // Never trust an index that points past the end of the file.
+        if(in.status() == QDataStream::Ok && entry.offset + static_cast<qint64>(bytesPerLine) * height <= size)
+            entries.insert(name, entry);
+    }
+}
+
+
+
+void SpriteAtlas::Close()
+{
+    entries.clear();
+    if(file && pixels)
+        file->unmap(const_cast<uchar *>(pixels));
+    pixels = nullptr;
+    file.reset();
+}
@@ -0,0 +1,88 @@
+/* SpriteAtlas.h
+Copyright (c) 2015 by Michael Zahniser
+
+Endless Sky is free software: you can redistribute it and/or modify it under the
+terms of the GNU General Public License as published by the Free Software
+Foundation, either version 3 of the License, or (at your option) any later version.
+
+Endless Sky is distributed in the hope that it will be useful, but WITHOUT ANY
+WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A
+PARTICULAR PURPOSE.  See the GNU General Public License for more details.
+*/
+
+#ifndef SPRITEATLAS_H
+#define SPRITEATLAS_H
+
+#include <QObject>
+
+#include <QFile>
+#include <QHash>
+#include <QImage>
+#include <QString>
+#include <QThreadPool>
+
+#include <atomic>
+#include <memory>
+
+
+
+// Class that keeps the sprites the system view uses (stars, planets, stations,
+// and asteroids) already decoded in a single file in the user's cache
+// directory. The file is memory mapped, so a sprite can be read from it with
+// no decoding and no file opens. The file records the sizes and modification
+// times of the images it was built from, and is rebuilt in the background if
+// they have changed. This object lives in the GUI thread.
+class SpriteAtlas : public QObject
+{
+    Q_OBJECT
+public:
+    // The atlas is only used if it is enabled (from the command line) before
+    // the sprite root path is first set.
+    static void Enable();
+    static bool IsEnabled();
+    static SpriteAtlas &Instance();
+    ~SpriteAtlas();
+
+    // Use the atlas for the given images directory, building it if needed.
+    // Until it is ready, Get() finds nothing.
+    void SetRoot(const QString &root);
+    // Get the named sprite, or a null image if it is not in the atlas. The
+    // image refers to the mapped file, so it must be copied (e.g. converted to
+    // a pixmap) rather than kept.
+    QImage Get(const QString &name) const;
+    // Stop using the atlas's copy of a sprite, e.g. because its file changed.
+    void Remove(const QString &name);
+
+signals:
+
+private slots:
+    void Ready(const QString &root);
+
+private:
+    explicit SpriteAtlas(QObject *parent = 0);
+    void Close();
+
+
+private:
+    class Entry {
+    public:
+        int width = 0;
+        int height = 0;
+        int bytesPerLine = 0;
+        qint64 offset = 0;
+    };
+    class BuildJob;
+
+    QString root;
+    QThreadPool pool;
+    // Flag telling the current build job to give up.
+    std::shared_ptr<std::atomic<bool>> cancelled;
+
+    std::unique_ptr<QFile> file;
+    const uchar *pixels = nullptr;
+    QHash<QString, Entry> entries;
+};
+
+
+
+#endif // SPRITEATLAS_H
@@ -0,0 +1,449 @@
+/* SpriteCatalog.cpp
+Copyright (c) 2015 by Michael Zahniser
+
+Endless Sky is free software: you can redistribute it and/or modify it under the
+terms of the GNU General Public License as published by the Free Software
+Foundation, either version 3 of the License, or (at your option) any later version.
+
+Endless Sky is distributed in the hope that it will be useful, but WITHOUT ANY
+WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A
+PARTICULAR PURPOSE.  See the GNU General Public License for more details.
+*/
+
+#include "SpriteCatalog.h"
+
+#include "Random.h"
+
+#include <QHash>
+
+#include <vector>
+
+using namespace std;
+
+namespace {
+    // For a star, "info" is how common that type of star is. For anything
+    // else, it is 1 for a habitable planet, 2 for a planet with city lights,
+    // and 3 for a station or some other special object.
+    struct Entry { const char *name; int radius; int info; };
+    constexpr Entry SPRITES[] = {
+        {"planet/callisto", 47, 0},
+        {"planet/cloud0", 76, 0},
+        {"planet/cloud1", 100, 0},
+        {"planet/cloud2", 101, 0},
+        {"planet/cloud3", 82, 0},
+        {"planet/cloud4", 91, 0},
+        {"planet/cloud5", 116, 0},
+        {"planet/cloud6", 86, 0},
+        {"planet/cloud7", 70, 0},
+        {"planet/cloud8", 77, 0},
+        {"planet/desert0", 75, 0},
+        {"planet/desert1", 96, 0},
+        {"planet/desert2", 81, 0},
+        {"planet/desert3", 85, 0},
+        {"planet/desert4", 33, 0},
+        {"planet/desert5", 82, 0},
+        {"planet/desert6", 85, 0},
+        {"planet/desert7", 64, 0},
+        {"planet/desert8", 74, 0},
+        {"planet/desert9", 66, 0},
+        {"planet/desert10", 86, 0},
+        {"planet/dust0", 28, 0},
+        {"planet/dust1", 42, 0},
+        {"planet/dust2", 51, 0},
+        {"planet/dust3", 37, 0},
+        {"planet/dust4", 42, 0},
+        {"planet/dust5", 47, 0},
+        {"planet/dust6", 57, 0},
+        {"planet/dust7", 37, 0},
+        {"planet/earth", 86, 2},
+        {"planet/europa", 31, 0},
+        {"planet/fog0", 107, 0},
+        {"planet/forest0", 97, 2},
+        {"planet/forest1", 81, 2},
+        {"planet/forest2", 90, 2},
+        {"planet/forest3", 71, 2},
+        {"planet/forest4", 94, 2},
+        {"planet/forest5", 83, 2},
+        {"planet/forest6", 69, 2},
+        {"planet/ganymede", 52, 0},
+        {"planet/gas0", 198, 0},
+        {"planet/gas1", 161, 0},
+        {"planet/gas2", 122, 0},
+        {"planet/gas3", 217, 0},
+        {"planet/gas4", 175, 0},
+        {"planet/gas5", 182, 0},
+        {"planet/gas6", 217, 0},
+        {"planet/gas7", 174, 0},
+        {"planet/gas8", 133, 0},
+        {"planet/gas9", 168, 0},
+        {"planet/gas10", 134, 0},
+        {"planet/gas11", 183, 0},
+        {"planet/gas12", 213, 0},
+        {"planet/gas13", 203, 0},
+        {"planet/gas14", 159, 0},
+        {"planet/gas15", 134, 0},
+        {"planet/gas16", 134, 0},
+        {"planet/gas17", 154, 0},
+        {"planet/ice0", 37, 0},
+        {"planet/ice1", 97, 0},
+        {"planet/ice2", 75, 0},
+        {"planet/ice3", 90, 0},
+        {"planet/ice4", 75, 0},
+        {"planet/ice5", 88, 0},
+        {"planet/ice6", 75, 0},
+        {"planet/ice7", 47, 0},
+        {"planet/ice8", 37, 0},
+        {"planet/io", 36, 0},
+        {"planet/jupiter", 189, 0},
+        {"planet/lava0", 48, 0},
+        {"planet/lava1", 53, 0},
+        {"planet/lava2", 50, 0},
+        {"planet/lava3", 64, 0},
+        {"planet/lava4", 74, 0},
+        {"planet/lava5", 66, 0},
+        {"planet/lava6", 56, 0},
+        {"planet/lava7", 60, 0},
+        {"planet/luna", 38, 0},
+        {"planet/mars", 72, 0},
+        {"planet/mercury", 53, 0},
+        {"planet/miranda", 33, 0},
+        {"planet/neptune", 139, 0},
+        {"planet/oberon", 28, 0},
+        {"planet/ocean0", 77, 1},
+        {"planet/ocean1", 87, 1},
+        {"planet/ocean2", 96, 1},
+        {"planet/ocean3", 81, 1},
+        {"planet/ocean4", 93, 1},
+        {"planet/ocean5", 77, 1},
+        {"planet/ocean6", 101, 1},
+        {"planet/ocean7", 82, 1},
+        {"planet/ocean8", 95, 1},
+        {"planet/ocean9", 86, 1},
+        {"planet/rhea", 43, 0},
+        {"planet/rock0", 37, 0},
+        {"planet/rock1", 79, 0},
+        {"planet/rock2", 83, 0},
+        {"planet/rock3", 37, 0},
+        {"planet/rock4", 93, 0},
+        {"planet/rock5", 60, 0},
+        {"planet/rock6", 75, 0},
+        {"planet/rock7", 32, 0},
+        {"planet/rock8", 65, 0},
+        {"planet/rock9", 74, 0},
+        {"planet/rock10", 98, 0},
+        {"planet/rock11", 55, 0},
+        {"planet/rock12", 85, 0},
+        {"planet/rock13", 75, 0},
+        {"planet/rock14", 46, 0},
+        {"planet/rock15", 56, 0},
+        {"planet/rock16", 71, 0},
+        {"planet/rock17", 28, 0},
+        {"planet/rock18", 75, 0},
+        {"planet/rock19", 72, 0},
+        {"planet/tethys", 28, 0},
+        {"planet/titan", 54, 0},
+        {"planet/uranus", 154, 0},
+        {"planet/venus", 80, 0},
+        {"planet/water0", 56, 1},
+        {"planet/water1", 96, 1},
+
+
+        {"planet/station0", 30, 3},
+        {"planet/station1", 30, 3},
+        {"planet/station1k", 35, 3},
+        {"planet/station1kd", 35, 3},
+        {"planet/station2", 35, 3},
+        {"planet/station2k", 45, 3},
+        {"planet/station2kd", 45, 3},
+        {"planet/station3", 35, 3},
+        {"planet/station3k", 55, 3},
+        {"planet/station3kd", 55, 3},
+        {"planet/station4", 45, 3},
+        {"planet/station5", 55, 3},
+        {"planet/station6", 65, 3},
+        {"planet/station7", 45, 3},
+
+        {"planet/wisp", 85, 3},
+        {"planet/wormhole", 195, 3},
+        {"planet/wormhole-red", 195, 3},
+
+        {"planet/ringworld", 20, 3},
+        {"planet/ringworld left", 20, 3},
+        {"planet/ringworld right", 20, 3},
+
+        {"star/b5", 60, 1},
+        {"star/a0", 50, 1},
+        {"star/a5", 45, 2},
+        {"star/f0", 39, 3},
+        {"star/f5", 35, 8},
+        {"star/f5-old", 35, 0},
+        {"star/g0", 30, 12},
+        {"star/g0-old", 30, 0},
+        {"star/g5", 25, 14},
+        {"star/g5-old", 25, 0},
+        {"star/k0", 23, 17},
+        {"star/k0-old", 23, 0},
+        {"star/k5", 22, 16},
+        {"star/k5-old", 22, 0},
+        {"star/m0", 20, 12},
+        {"star/m4", 18, 9},
+        {"star/m8", 15, 5},
+        {"star/giant", 50, 0},
+        {"star/nova", 12, 0},
+        {"star/wr", 25, 0}
+    };
+    constexpr int COUNT = sizeof(SPRITES) / sizeof(SPRITES[0]);
+    static_assert(COUNT <= SpriteCatalog::MAX_SPRITES, "Too many sprites for a SpriteCatalog::Set.");
+
+    constexpr bool StartsWith(const char *text, const char *prefix)
+    {
+        return !*prefix || (*text == *prefix && StartsWith(text + 1, prefix + 1));
+    }
+
+    // Figure out which categories each sprite is in. This is all done at
+    // compile time, so the checks below can make sure every category can
+    // actually be picked from.
+    constexpr bool InCategory(int id, SpriteCatalog::Category category)
+    {
+        return (category == SpriteCatalog::STAR) ? StartsWith(SPRITES[id].name, "star/")
+            : !StartsWith(SPRITES[id].name, "planet/") ? false
+            : (category == SpriteCatalog::STATION) ? (SPRITES[id].info == 3)
+            : (SPRITES[id].info == 3) ? false
+            : (category == SpriteCatalog::MOON) ? (SPRITES[id].radius < SpriteCatalog::MOON_RADIUS)
+            : (category == SpriteCatalog::GIANT) ? (SPRITES[id].radius >= SpriteCatalog::GIANT_RADIUS)
+            : (SPRITES[id].radius >= SpriteCatalog::MOON_RADIUS && SPRITES[id].radius < SpriteCatalog::GIANT_RADIUS)
+                && (category == SpriteCatalog::PLANET || !SPRITES[id].info);
+    }
+    constexpr int Weight(int id, SpriteCatalog::Category category)
+    {
+        return !InCategory(id, category) ? 0 : (category == SpriteCatalog::STAR) ? SPRITES[id].info : 1;
+    }
+    constexpr int TotalWeight(SpriteCatalog::Category category, int id = 0)
+    {
+        return (id == COUNT) ? 0 : Weight(id, category) + TotalWeight(category, id + 1);
+    }
+    static_assert(TotalWeight(SpriteCatalog::STAR) == 100, "Star weights should add up to 100.");
+    static_assert(TotalWeight(SpriteCatalog::MOON) && TotalWeight(SpriteCatalog::PLANET)
+        && TotalWeight(SpriteCatalog::UNINHABITED) && TotalWeight(SpriteCatalog::GIANT)
+        && TotalWeight(SpriteCatalog::STATION), "Every category needs at least one sprite.");
+    // Systems that may not have inhabited objects are built from these kinds
+    // of objects, so each kind needs a sprite without city lights.
+    constexpr int UninhabitedCount(SpriteCatalog::Category category, int id = 0)
+    {
+        return (id == COUNT) ? 0 : (InCategory(id, category) && SPRITES[id].info != 2)
+            + UninhabitedCount(category, id + 1);
+    }
+    static_assert(UninhabitedCount(SpriteCatalog::MOON) && UninhabitedCount(SpriteCatalog::PLANET)
+        && UninhabitedCount(SpriteCatalog::UNINHABITED) && UninhabitedCount(SpriteCatalog::GIANT),
+        "Every kind of planet needs an uninhabited sprite.");
+
+    // Table for picking weighted random items in constant time (Walker's
+    // alias method). Each slot is picked with equal probability; it then
+    // gives either its own item or its alias, so that every item ends up with
+    // the right share of the total probability.
+    class Sampler {
+    public:
+        void Build(const vector<int> &ids, const vector<int> &weights);
+        int Pick(Random &random) const;
+        int Pick(Random &random, const SpriteCatalog::Set &exclude) const;
+
+    private:
+        vector<int> ids;
+        vector<int> weights;
+        vector<double> probability;
+        vector<int> alias;
+    };
+
+    void Sampler::Build(const vector<int> &ids, const vector<int> &weights)
+    {
+        this->ids = ids;
+        this->weights = weights;
+        const int count = ids.size();
+        int total = 0;
+        for(int weight : weights)
+            total += weight;
+
+        // Scale the weights so the average is 1. Each slot whose share is too
+        // small is topped up from a slot whose share is too big.
+        vector<double> share(count);
+        vector<int> small;
+        vector<int> large;
+        for(int i = 0; i < count; ++i)
+        {
+            share[i] = static_cast<double>(weights[i]) * count / total;
+            (share[i] < 1. ? small : large).push_back(i);
+        }
+        probability.assign(count, 1.);
+        alias.resize(count);
+        for(int i = 0; i < count; ++i)
+            alias[i] = i;
+        while(!small.empty() && !large.empty())
+        {
+            int less = small.back();
+            small.pop_back();
+            int more = large.back();
+            large.pop_back();
+
+            probability[less] = share[less];
+            alias[less] = more;
+            share[more] += share[less] - 1.;
+            (share[more] < 1. ? small : large).push_back(more);
+        }
+    }
+
+    int Sampler::Pick(Random &random) const
+    {
+        int slot = random.Int(ids.size());
+        return ids[random.Real() < probability[slot] ? slot : alias[slot]];
+    }
+
+    // Picking from the whole table and then, only if that pick is excluded,
+    // from the remaining items by weight gives each remaining item the same
+    // chance it would have if the excluded ones had never been in the table.
+    // Either way, this takes at most one pass over the table.
+    int Sampler::Pick(Random &random, const SpriteCatalog::Set &exclude) const
+    {
+        int id = Pick(random);
+        if(!exclude[id])
+            return id;
+
+        int total = 0;
+        for(size_t i = 0; i < ids.size(); ++i)
+            if(!exclude[ids[i]])
+                total += weights[i];
+        if(!total)
+            return -1;
+
+        int r = random.Int(total);
+        for(size_t i = 0; true; ++i)
+            if(!exclude[ids[i]])
+            {
+                r -= weights[i];
+                if(r < 0)
+                    return ids[i];
+            }
+    }
+
+    // Everything about the catalog that is figured out when the program runs.
+    class Catalog {
+    public:
+        Catalog();
+
+        QHash<QString, int> ids;
+        vector<QString> names;
+        vector<bool> isStar;
+        vector<bool> isStation;
+        vector<bool> isInhabited;
+        SpriteCatalog::Set inhabited;
+        Sampler samplers[SpriteCatalog::CATEGORIES];
+    };
+
+    Catalog::Catalog()
+    {
+        for(int id = 0; id < COUNT; ++id)
+        {
+            names.emplace_back(SPRITES[id].name);
+            ids.insert(names.back(), id);
+            isStar.push_back(StartsWith(SPRITES[id].name, "star"));
+            isStation.push_back(StartsWith(SPRITES[id].name, "planet/station"));
+            isInhabited.push_back(!isStar.back() && (isStation.back() || SPRITES[id].info == 2));
+            inhabited[id] = isInhabited.back();
+        }
+        for(int i = 0; i < SpriteCatalog::CATEGORIES; ++i)
+        {
+            SpriteCatalog::Category category = static_cast<SpriteCatalog::Category>(i);
+            vector<int> members;
+            vector<int> weights;
+            for(int id = 0; id < COUNT; ++id)
+                if(Weight(id, category))
+                {
+                    members.push_back(id);
+                    weights.push_back(Weight(id, category));
+                }
+            samplers[i].Build(members, weights);
+        }
+    }
+
+    const Catalog &GetCatalog()
+    {
+        static const Catalog catalog;
+        return catalog;
+    }
+}
+
+
+
+int SpriteCatalog::Find(const QString &name)
+{
+    return GetCatalog().ids.value(name, -1);
+}
+
+
+
+int SpriteCatalog::Count()
+{
+    return COUNT;
+}
+
+
+
+const QString &SpriteCatalog::Name(int id)
+{
+    return GetCatalog().names[id];
+}
+
+
+
+int SpriteCatalog::Radius(int id)
+{
+    return SPRITES[id].radius;
+}
+
+
+
+bool SpriteCatalog::IsStar(int id)
+{
+    return GetCatalog().isStar[id];
+}
+
+
+
+bool SpriteCatalog::IsStation(int id)
+{
+    return GetCatalog().isStation[id];
+}
+
+
+
+bool SpriteCatalog::IsInhabited(int id)
+{
+    return GetCatalog().isInhabited[id];
+}
+
+
+
+bool SpriteCatalog::IsIn(int id, Category category)
+{
+    return InCategory(id, category);
+}
+
+
+
+const SpriteCatalog::Set &SpriteCatalog::Inhabited()
+{
+    return GetCatalog().inhabited;
+}
+
+
+
+int SpriteCatalog::Pick(Category category, Random &random)
+{
+    return GetCatalog().samplers[category].Pick(random);
+}
+
+
+
+int SpriteCatalog::Pick(Category category, Random &random, const Set &exclude)
+{
+    return GetCatalog().samplers[category].Pick(random, exclude);
+}
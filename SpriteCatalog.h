@@ -0,0 +1,82 @@
+/* SpriteCatalog.h
+Copyright (c) 2015 by Michael Zahniser
+
+Endless Sky is free software: you can redistribute it and/or modify it under the
+terms of the GNU General Public License as published by the Free Software
+Foundation, either version 3 of the License, or (at your option) any later version.
+
+Endless Sky is distributed in the hope that it will be useful, but WITHOUT ANY
+WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A
+PARTICULAR PURPOSE.  See the GNU General Public License for more details.
+*/
+
+#ifndef SPRITE_CATALOG_H_
+#define SPRITE_CATALOG_H_
+
+#include <QString>
+
+#include <bitset>
+
+class Random;
+
+
+
+// Class listing the stellar object sprites that the system generator knows
+// about: how big each one is, and what kind of object it shows. Each sprite's
+// ID is its place in the list, so looking up anything about a sprite is just
+// an array index, and each kind of object has a precomputed table for picking
+// one of its sprites at random in constant time.
+class SpriteCatalog {
+public:
+    // Objects smaller than this are moons; objects this big or bigger are
+    // gas giants.
+    static const int MOON_RADIUS = 50;
+    static const int GIANT_RADIUS = 120;
+    // The catalog may hold up to this many sprites.
+    static const int MAX_SPRITES = 256;
+    // A set of sprites, e.g. the ones that are already used in a system, with
+    // one bit per sprite ID.
+    typedef std::bitset<MAX_SPRITES> Set;
+
+    // Kinds of objects that the generator picks sprites for.
+    enum Category {
+        STAR,
+        MOON,
+        // A planet that is neither a moon nor a gas giant. It may or may not
+        // be habitable.
+        PLANET,
+        // A planet that can exist outside the habitable zone.
+        UNINHABITED,
+        GIANT,
+        STATION,
+        CATEGORIES
+    };
+
+
+public:
+    // Get the ID of the named sprite, or -1 if it is not in the catalog.
+    static int Find(const QString &name);
+    static int Count();
+
+    static const QString &Name(int id);
+    static int Radius(int id);
+    static bool IsStar(int id);
+    static bool IsStation(int id);
+    // Check if the sprite shows a definitely inhabited object, i.e. a station
+    // or a planet with city lights.
+    static bool IsInhabited(int id);
+    static bool IsIn(int id, Category category);
+    // Get the set of all the inhabited sprites.
+    static const Set &Inhabited();
+
+    // Pick a random sprite of the given kind. Stars are weighted by how common
+    // each type of star is; all other sprites are equally likely.
+    static int Pick(Category category, Random &random);
+    // Pick a random sprite of the given kind that is not in the given set.
+    // This returns -1 if every sprite of that kind is in the set.
+    static int Pick(Category category, Random &random, const Set &exclude);
+};
+
+
+
+#endif
@@ -0,0 +1,240 @@
+/* SpriteIndex.cpp
+Copyright (c) 2015 by Michael Zahniser
+
+Endless Sky is free software: you can redistribute it and/or modify it under the
+terms of the GNU General Public License as published by the Free Software
+Foundation, either version 3 of the License, or (at your option) any later version.
+
+Endless Sky is distributed in the hope that it will be useful, but WITHOUT ANY
+WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A
+PARTICULAR PURPOSE.  See the GNU General Public License for more details.
+*/
+
+#include "SpriteIndex.h"
+
+#include "SpriteSet.h"
+
+#include <QApplication>
+#include <QDir>
+#include <QDirIterator>
+#include <QFileInfo>
+#include <QMetaObject>
+#include <QMutexLocker>
+#include <QRunnable>
+#include <QStringList>
+
+using namespace std;
+
+namespace {
+    const QStringList FILTERS = {"*.jpg", "*.png"};
+
+    // Get the name of the sprite stored in the given file.
+    QString SpriteName(const QDir &root, const QFileInfo &file)
+    {
+        QString name = root.relativeFilePath(file.filePath());
+        name.chop(file.suffix().length() + 1);
+        return name;
+    }
+
+    // Check if a file with the given suffix should replace the sprite's entry.
+    // If a sprite is stored as both a jpg and a png, the jpg is always used.
+    bool Replaces(const QHash<QString, QString> &extensions, const QString &name, const QString &suffix)
+    {
+        auto it = extensions.find(name);
+        return it == extensions.end() || (suffix == "jpg" && it.value() != suffix);
+    }
+}
+
+
+
+class SpriteIndex::Scan {
+public:
+    QString root;
+    QHash<QString, QString> extensions;
+    QStringList directories;
+};
+
+
+
+// Job that lists the whole images tree.
+class SpriteIndex::ScanJob : public QRunnable {
+public:
+    ScanJob(SpriteIndex *index, const QString &root, const shared_ptr<atomic<bool>> &cancelled)
+        : index(index), root(root), cancelled(cancelled) {}
+
+    virtual void run() override
+    {
+        shared_ptr<Scan> scan(new Scan);
+        scan->root = root;
+        QDir dir(root);
+        scan->directories.append(dir.path());
+        QDirIterator it(dir.path(), FILTERS, QDir::Files | QDir::AllDirs | QDir::NoDotAndDotDot,
+            QDirIterator::Subdirectories);
+        while(it.hasNext())
+        {
+            if(*cancelled)
+                return;
+            it.next();
+            if(it.fileInfo().isDir())
+                scan->directories.append(it.filePath());
+            else
+            {
+                QString name = SpriteName(dir, it.fileInfo());
+                if(Replaces(scan->extensions, name, it.fileInfo().suffix()))
+                    scan->extensions.insert(name, it.fileInfo().suffix());
+            }
+        }
+
+        {
+            QMutexLocker lock(&index->mutex);
+            if(*cancelled)
+                return;
+            index->finished = scan;
+        }
+        QMetaObject::invokeMethod(index, "ScanFinished", Qt::QueuedConnection);
+    }
+
+
+private:
+    SpriteIndex *index;
+    QString root;
+    shared_ptr<atomic<bool>> cancelled;
+};
+
+
+
+SpriteIndex &SpriteIndex::Instance()
+{
+    static SpriteIndex *index = new SpriteIndex(qApp);
+    return *index;
+}
+
+
+
+SpriteIndex::SpriteIndex(QObject *parent) :
+    QObject(parent)
+{
+    connect(&watcher, SIGNAL(directoryChanged(const QString &)), this, SLOT(DirectoryChanged(const QString &)));
+    pool.setMaxThreadCount(1);
+}
+
+
+
+// The scan refers to this object, so it must be stopped before this is gone.
+SpriteIndex::~SpriteIndex()
+{
+    pool.clear();
+    if(cancelled)
+        *cancelled = true;
+    pool.waitForDone();
+}
+
+
+
+void SpriteIndex::SetRoot(const QString &root)
+{
+    if(root == this->root)
+        return;
+
+    this->root = root;
+    isReady = false;
+    extensions.clear();
+    if(!watcher.directories().isEmpty())
+        watcher.removePaths(watcher.directories());
+    if(cancelled)
+        *cancelled = true;
+    if(!root.isEmpty())
+    {
+        cancelled.reset(new atomic<bool>(false));
+        pool.start(new ScanJob(this, root, cancelled));
+    }
+}
+
+
+
+bool SpriteIndex::IsReady() const
+{
+    return isReady;
+}
+
+
+
+QString SpriteIndex::Extension(const QString &name) const
+{
+    return extensions.value(name);
+}
+
+
+
+void SpriteIndex::ScanFinished()
+{
+    shared_ptr<Scan> scan;
+    {
+        QMutexLocker lock(&mutex);
+        scan.swap(finished);
+    }
+    // Ignore scans of a directory that is no longer in use.
+    if(!scan || scan->root != root)
+        return;
+
+    extensions.swap(scan->extensions);
+    watcher.addPaths(scan->directories);
+    isReady = true;
+}
+
+
+
+// A file was added to or removed from the given directory. Listing just that
+// directory is much cheaper than scanning the whole tree again.
+void SpriteIndex::DirectoryChanged(const QString &path)
+{
+    if(isReady)
+        Rescan(path);
+}
+
+
+
+void SpriteIndex::Rescan(const QString &path)
+{
+    QDir rootDir(root);
+    QString prefix = rootDir.relativeFilePath(path);
+    if(prefix == ".")
+        prefix.clear();
+    else if(!prefix.endsWith('/'))
+        prefix += '/';
+
+    // Drop the entries for this directory that no longer have files.
+    QDir dir(path);
+    for(auto it = extensions.begin(); it != extensions.end(); )
+    {
+        if(it.key().startsWith(prefix) && it.key().indexOf('/', prefix.length()) < 0
+                && !dir.exists(it.key().mid(prefix.length()) + "." + it.value()))
+        {
+            SpriteSet::Forget(it.key());
+            it = extensions.erase(it);
+        }
+        else
+            ++it;
+    }
+
+    // Add any new files, and watch any new directories.
+    for(const QFileInfo &file : dir.entryInfoList(FILTERS, QDir::Files | QDir::AllDirs | QDir::NoDotAndDotDot))
+    {
+        if(file.isDir())
+        {
+            if(!watcher.directories().contains(file.filePath()))
+            {
+                watcher.addPath(file.filePath());
+                Rescan(file.filePath());
+            }
+            continue;
+        }
+        QString name = SpriteName(rootDir, file);
+        if(Replaces(extensions, name, file.suffix()))
+        {
+            extensions.insert(name, file.suffix());
+            // If this sprite was looked for before, it was recorded as missing.
+            SpriteSet::Forget(name);
+        }
+    }
+}
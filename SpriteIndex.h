@@ -0,0 +1,83 @@
+/* SpriteIndex.h
+Copyright (c) 2015 by Michael Zahniser
+
+Endless Sky is free software: you can redistribute it and/or modify it under the
+terms of the GNU General Public License as published by the Free Software
+Foundation, either version 3 of the License, or (at your option) any later version.
+
+Endless Sky is distributed in the hope that it will be useful, but WITHOUT ANY
+WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A
+PARTICULAR PURPOSE.  See the GNU General Public License for more details.
+*/
+
+#ifndef SPRITEINDEX_H
+#define SPRITEINDEX_H
+
+#include <QObject>
+
+#include <QFileSystemWatcher>
+#include <QHash>
+#include <QMutex>
+#include <QString>
+#include <QThreadPool>
+
+#include <atomic>
+#include <memory>
+
+
+
+// Class that lists every image file in the images directory, so that checking
+// whether a sprite exists never has to touch the file system. The directory
+// tree is scanned once in the background, and then a file system watcher keeps
+// the list current. This object lives in the GUI thread.
+class SpriteIndex : public QObject
+{
+    Q_OBJECT
+public:
+    static SpriteIndex &Instance();
+    ~SpriteIndex();
+
+    // Start scanning the given images directory. Until the scan is done, the
+    // index is not ready, and sprites must be looked for on disk.
+    void SetRoot(const QString &root);
+    bool IsReady() const;
+    // Get the extension ("jpg" or "png") of the named sprite's file, or an
+    // empty string if there is no such sprite.
+    QString Extension(const QString &name) const;
+
+signals:
+
+private slots:
+    void ScanFinished();
+    void DirectoryChanged(const QString &path);
+
+private:
+    explicit SpriteIndex(QObject *parent = 0);
+    // Update the index for all the files directly inside the given directory.
+    void Rescan(const QString &path);
+
+
+private:
+    class Scan;
+    class ScanJob;
+
+    QString root;
+    bool isReady = false;
+    // Map from sprite name to file extension.
+    QHash<QString, QString> extensions;
+    QFileSystemWatcher watcher;
+
+    // Scans run one at a time, so a scan that finishes is always newer than
+    // any that finished before it. A scan of a root that is no longer in use
+    // is cancelled, and then never replaces the finished scan.
+    QThreadPool pool;
+    std::shared_ptr<std::atomic<bool>> cancelled;
+
+    // This mutex controls access to the most recently finished scan.
+    QMutex mutex;
+    std::shared_ptr<Scan> finished;
+};
+
+
+
+#endif // SPRITEINDEX_H
@@ -0,0 +1,118 @@
+/* SpriteQueue.cpp
+Copyright (c) 2015 by Michael Zahniser
+
+Endless Sky is free software: you can redistribute it and/or modify it under the
+terms of the GNU General Public License as published by the Free Software
+Foundation, either version 3 of the License, or (at your option) any later version.
+
+Endless Sky is distributed in the hope that it will be useful, but WITHOUT ANY
+WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A
+PARTICULAR PURPOSE.  See the GNU General Public License for more details.
+*/
+
+#include "SpriteQueue.h"
+
+#include "SpriteSet.h"
+
+#include <QApplication>
+#include <QFileInfo>
+#include <QMetaObject>
+#include <QRunnable>
+
+using namespace std;
+
+namespace {
+    // Thread pool priorities. Higher priority jobs are started first.
+    const int PRELOAD_PRIORITY = 0;
+    const int VISIBLE_PRIORITY = 1;
+
+    // Job that decodes a single sprite, and hands it back to the queue.
+    class LoadJob : public QRunnable {
+    public:
+        LoadJob(SpriteQueue *queue, const QString &name, const QString &path)
+            : queue(queue), name(name), path(path) {}
+
+        virtual void run() override
+        {
+            QImage image;
+            if(path.endsWith(".jpg") || path.endsWith(".png"))
+                image.load(path);
+            else if(QFileInfo(path + ".jpg").exists())
+                image.load(path + ".jpg");
+            else
+            {
+                QFileInfo png(path + ".png");
+                if(png.exists())
+                    image.load(png.filePath());
+            }
+            QMetaObject::invokeMethod(queue, "Finished", Qt::QueuedConnection,
+                Q_ARG(QString, name), Q_ARG(QImage, image));
+        }
+
+    private:
+        SpriteQueue *queue;
+        QString name;
+        QString path;
+    };
+}
+
+
+
+SpriteQueue &SpriteQueue::Instance()
+{
+    // The queue belongs to the application, so that it is destroyed (and
+    // its workers are finished) before the rest of Qt shuts down.
+    static SpriteQueue *queue = new SpriteQueue(qApp);
+    return *queue;
+}
+
+
+
+SpriteQueue::SpriteQueue(QObject *parent) :
+    QObject(parent)
+{
+}
+
+
+
+SpriteQueue::~SpriteQueue()
+{
+    // Drop any queued decodes, and let the ones in progress finish. The jobs
+    // themselves are deleted along with the list of pending sprites.
+    pool.clear();
+    pool.waitForDone();
+}
+
+
+
+void SpriteQueue::Load(const QString &name, const QString &path, bool isVisible)
+{
+    auto it = pending.find(name);
+    if(it == pending.end())
+    {
+        Pending &entry = pending[name];
+        entry.job.reset(new LoadJob(this, name, path));
+        entry.job->setAutoDelete(false);
+        entry.isVisible = isVisible;
+        pool.start(entry.job.get(), isVisible ? VISIBLE_PRIORITY : PRELOAD_PRIORITY);
+    }
+    else if(isVisible && !it->second.isVisible)
+    {
+        // The sprite is needed now. If it has not been started yet, take it
+        // out of the queue and put it back in at a higher priority.
+        it->second.isVisible = true;
+        if(pool.tryTake(it->second.job.get()))
+            pool.start(it->second.job.get(), VISIBLE_PRIORITY);
+    }
+}
+
+
+
+// The job has returned from run() by the time this is called, so it is safe
+// to delete it.
+void SpriteQueue::Finished(const QString &name, const QImage &image)
+{
+    pending.erase(name);
+    SpriteSet::Set(name, image);
+    emit Loaded(name);
+}
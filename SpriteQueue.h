@@ -0,0 +1,71 @@
+/* SpriteQueue.h
+Copyright (c) 2015 by Michael Zahniser
+
+Endless Sky is free software: you can redistribute it and/or modify it under the
+terms of the GNU General Public License as published by the Free Software
+Foundation, either version 3 of the License, or (at your option) any later version.
+
+Endless Sky is distributed in the hope that it will be useful, but WITHOUT ANY
+WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A
+PARTICULAR PURPOSE.  See the GNU General Public License for more details.
+*/
+
+#ifndef SPRITEQUEUE_H
+#define SPRITEQUEUE_H
+
+#include <QObject>
+
+#include <QImage>
+#include <QString>
+#include <QThreadPool>
+
+#include <map>
+#include <memory>
+
+class QRunnable;
+
+
+
+// Class that decodes sprites on worker threads, so that painting never has to
+// wait for an image to be read from disk. Sprites that are about to be drawn
+// are decoded before ones that are only being preloaded. When an image is
+// ready it is added to the SpriteSet, and Loaded() is emitted so that any view
+// showing it can repaint. This object lives in the GUI thread.
+class SpriteQueue : public QObject
+{
+    Q_OBJECT
+public:
+    static SpriteQueue &Instance();
+    ~SpriteQueue();
+
+    // Queue the sprite with the given name and path. If the path has no file
+    // extension, a ".jpg" and then a ".png" file are looked for. If the sprite
+    // is already queued, but not as visible, move it up.
+    void Load(const QString &name, const QString &path, bool isVisible);
+
+signals:
+    void Loaded(const QString &name);
+
+private slots:
+    void Finished(const QString &name, const QImage &image);
+
+private:
+    explicit SpriteQueue(QObject *parent = 0);
+
+
+private:
+    QThreadPool pool;
+    // Sprites that are queued or being decoded, and whether they are visible.
+    // The queue owns each job until its sprite is finished, so a job that has
+    // already run can never be re-queued after the pool has deleted it.
+    class Pending {
+    public:
+        std::unique_ptr<QRunnable> job;
+        bool isVisible;
+    };
+    std::map<QString, Pending> pending;
+};
+
+
+
+#endif // SPRITEQUEUE_H
@@ -12,56 +12,196 @@ PARTICULAR PURPOSE.  See the GNU General Public License for more details.
 
 #include "SpriteSet.h"
 
-#include <QFileInfo>
+#include "SpriteAtlas.h"
+#include "SpriteIndex.h"
+#include "SpriteQueue.h"
+
+#include <QMutex>
+#include <QMutexLocker>
 #include <QString>
 
+#include <algorithm>
+#include <cmath>
+#include <list>
 #include <map>
+#include <vector>
 
 using namespace std;
 
 namespace {
+    const qint64 DEFAULT_BUDGET = 256 << 20;
+
+    class Entry {
+    public:
+        // The full-size sprite, followed by whichever mip levels have been
+        // made so far.
+        vector<QPixmap> levels;
+        qint64 bytes = 0;
+        // This sprite's place in the list of recently used sprites.
+        list<QString>::iterator use;
+    };
+
+    // This mutex controls access to the following:
+    QMutex mutex;
     QString root;
-    map<QString, QPixmap> sprite;
+    map<QString, Entry> sprites;
+    // Names of the cached sprites, most recently used first.
+    list<QString> recent;
+    qint64 budget = DEFAULT_BUDGET;
+    SpriteSet::Stats stats;
+
+    qint64 Bytes(const QPixmap &pixmap)
+    {
+        return static_cast<qint64>(pixmap.width()) * pixmap.height() * max(1, pixmap.depth() / 8);
+    }
+
+    // Drop the least recently used sprites until the cache fits in its budget.
+    // The most recently used sprite is always kept, so that a sprite bigger
+    // than the whole budget can still be drawn. The mutex must be held.
+    void Evict()
+    {
+        while(stats.bytes > budget && recent.size() > 1)
+        {
+            auto it = sprites.find(recent.back());
+            stats.bytes -= it->second.bytes;
+            ++stats.evictions;
+            sprites.erase(it);
+            recent.pop_back();
+        }
+    }
+
+    // Queue the named sprite to be loaded. A sprite that is in the atlas is
+    // copied from it right away, and once the sprite index is ready, a sprite
+    // that has no file is recorded as missing without touching the disk.
+    // Returns true if the sprite was set without being queued. The mutex must
+    // not be held.
+    bool Queue(const QString &name, const QString &root, bool isVisible)
+    {
+        if(SpriteAtlas::IsEnabled())
+        {
+            // The atlas image refers to the mapped file, so keep a copy.
+            QImage image = SpriteAtlas::Instance().Get(name);
+            if(!image.isNull())
+            {
+                SpriteSet::Set(name, image.copy());
+                return true;
+            }
+        }
+
+        const SpriteIndex &index = SpriteIndex::Instance();
+        QString path = root + name;
+        if(index.IsReady())
+        {
+            QString extension = index.Extension(name);
+            if(extension.isEmpty())
+            {
+                SpriteSet::Set(name, QImage());
+                return true;
+            }
+            path += "." + extension;
+        }
+        SpriteQueue::Instance().Load(name, path, isVisible);
+        return false;
+    }
 }
 
 
 
 void SpriteSet::SetRootPath(const QString &path)
 {
-    root = path;
-    if(!root.isEmpty() && !root.endsWith('/'))
-        root += '/';
+    QString newRoot = path;
+    if(!newRoot.isEmpty() && !newRoot.endsWith('/'))
+        newRoot += '/';
+    {
+        QMutexLocker lock(&mutex);
+        root = newRoot;
+    }
+    SpriteIndex::Instance().SetRoot(newRoot);
+    if(SpriteAtlas::IsEnabled())
+        SpriteAtlas::Instance().SetRoot(newRoot);
 }
 
 
 
-const QString &SpriteSet::RootPath()
+QString SpriteSet::RootPath()
 {
+    QMutexLocker lock(&mutex);
     return root;
 }
 
 
 
+// Get the named sprite. If it is not loaded yet (or was evicted), and is not
+// in the sprite atlas, this returns a null pixmap and queues it to be loaded;
+// SpriteQueue::Loaded() is emitted once it is.
 QPixmap SpriteSet::Get(const QString &name)
 {
-    auto it = sprite.find(name);
-    if(it != sprite.end())
-        return it->second;
+    return Get(name, 1.);
+}
 
-    QPixmap image;
 
-    QString baseName = root + name;
-    QFileInfo jpg(baseName + ".jpg");
-    if(jpg.exists())
-        image.load(jpg.filePath());
-    else
+
+QPixmap SpriteSet::Get(const QString &name, double scale)
+{
+    const size_t level = Level(scale);
+    QString path;
     {
-        QFileInfo png(baseName + ".png");
-        if(png.exists())
-            image.load(png.filePath());
+        QMutexLocker lock(&mutex);
+        auto it = sprites.find(name);
+        if(it != sprites.end())
+        {
+            ++stats.hits;
+            Entry &entry = it->second;
+            recent.splice(recent.begin(), recent, entry.use);
+
+            // Make any missing mip levels by halving the previous one. Repeated
+            // halving averages every source pixel, unlike scaling the full-size
+            // sprite down in one step.
+            while(entry.levels.size() <= level && !entry.levels.back().isNull())
+            {
+                const QPixmap &larger = entry.levels.back();
+                QPixmap smaller = larger.scaled(max(1, larger.width() / 2), max(1, larger.height() / 2),
+                    Qt::IgnoreAspectRatio, Qt::SmoothTransformation);
+                entry.bytes += Bytes(smaller);
+                stats.bytes += Bytes(smaller);
+                entry.levels.push_back(smaller);
+            }
+            QPixmap result = entry.levels[min(level, entry.levels.size() - 1)];
+            Evict();
+            return result;
+        }
+        ++stats.misses;
+        path = root;
     }
-    sprite[name] = image;
-    return image;
+    if(Queue(name, path, true))
+        return Get(name, scale);
+    return QPixmap();
+}
+
+
+
+int SpriteSet::Level(double scale)
+{
+    if(scale >= 1.)
+        return 0;
+    // Allow for rounding error, so that a scale of exactly 1/2 uses level 1.
+    return min(LEVELS - 1, static_cast<int>(floor(-log2(scale) + 1e-9)));
+}
+
+
+
+// Start loading the named sprite in the background, after any sprites that
+// are waiting to be drawn.
+void SpriteSet::Preload(const QString &name)
+{
+    QString path;
+    {
+        QMutexLocker lock(&mutex);
+        if(sprites.count(name))
+            return;
+        path = root;
+    }
+    Queue(name, path, false);
 }
 
 
@@ -69,8 +209,55 @@ QPixmap SpriteSet::Get(const QString &name)
 // Set an entry in the set (using an image loaded elsewhere).
 void SpriteSet::Set(const QString &name, QImage image)
 {
-    if(sprite.count(name))
+    QMutexLocker lock(&mutex);
+    if(sprites.count(name))
+        return;
+
+    Entry &entry = sprites[name];
+    entry.levels.push_back(QPixmap::fromImage(image));
+    entry.bytes = Bytes(entry.levels.back());
+    recent.push_front(name);
+    entry.use = recent.begin();
+    stats.bytes += entry.bytes;
+    Evict();
+}
+
+
+
+// Drop the named sprite, e.g. because its file was added or removed. If it is
+// drawn again, it will be reloaded.
+void SpriteSet::Forget(const QString &name)
+{
+    if(SpriteAtlas::IsEnabled())
+        SpriteAtlas::Instance().Remove(name);
+
+    QMutexLocker lock(&mutex);
+    auto it = sprites.find(name);
+    if(it == sprites.end())
         return;
 
-    sprite[name] = QPixmap::fromImage(image);
+    stats.bytes -= it->second.bytes;
+    recent.erase(it->second.use);
+    sprites.erase(it);
+}
+
+
+
+// Set how many bytes of decoded sprites (including their mip levels) may be
+// kept in memory. The least recently used ones are dropped first.
+void SpriteSet::SetBudget(qint64 bytes)
+{
+    QMutexLocker lock(&mutex);
+    budget = bytes;
+    Evict();
+}
+
+
+
+SpriteSet::Stats SpriteSet::GetStats()
+{
+    QMutexLocker lock(&mutex);
+    Stats result = stats;
+    result.budget = budget;
+    return result;
 }
@@ -13,20 +13,60 @@ PARTICULAR PURPOSE.  See the GNU General Public License for more details.
 #ifndef SPRITESET_H
 #define SPRITESET_H
 
+#include <QImage>
 #include <QPixmap>
 #include <QString>
+#include <QtGlobal>
 
 
 
 class SpriteSet {
+public:
+    // Number of mip levels, each half the size of the previous one. Level 0 is
+    // the full-size sprite.
+    static const int LEVELS = 5;
+
+    // Counters describing how well the cache is working.
+    class Stats {
+    public:
+        // Number of lookups that found the sprite already loaded, or not.
+        qint64 hits = 0;
+        qint64 misses = 0;
+        // Number of sprites dropped to stay within the budget.
+        qint64 evictions = 0;
+        // Memory used by the loaded sprites, and the limit on it.
+        qint64 bytes = 0;
+        qint64 budget = 0;
+    };
+
+
 public:
     static void SetRootPath(const QString &path);
-    static const QString &RootPath();
+    static QString RootPath();
 
+    // Get the named sprite. If it has not been loaded yet, this returns a null
+    // pixmap right away and loads the sprite in the background; SpriteQueue
+    // signals when it arrives.
     static QPixmap Get(const QString &name);
+    // Get the mip level of the named sprite that best matches drawing it at
+    // the given scale. It should be drawn into the full-size sprite's bounds.
+    static QPixmap Get(const QString &name, double scale);
+    // Get the smallest mip level that has at least as much detail as the
+    // full-size sprite drawn at the given scale.
+    static int Level(double scale);
+    // Load a sprite that is likely to be drawn soon, at a lower priority than
+    // the sprites that are being drawn now.
+    static void Preload(const QString &name);
 
     // Set an entry in the set (using an image loaded elsewhere).
     static void Set(const QString &name, QImage image);
+    // Drop the named sprite, so that it is reloaded the next time it is drawn.
+    static void Forget(const QString &name);
+
+    // Set the number of bytes that loaded sprites may use. If more are needed,
+    // the least recently drawn ones are dropped, and reloaded when next drawn.
+    static void SetBudget(qint64 bytes);
+    static Stats GetStats();
 };
 
 
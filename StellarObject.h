@@ -14,6 +14,7 @@ PARTICULAR PURPOSE.  See the GNU General Public License for more details.
 #define STELLAR_OBJECT_H_
 
 #include "DataNode.h"
+#include "SpriteCatalog.h"
 
 #include <QVector2D>
 #include <QString>
@@ -33,6 +34,9 @@ public:
     // Some objects do not have sprites, because they are just an orbital
     // center for two or more other objects.
     const QString &Sprite() const;
+    // Get this object's place in the sprite catalog, or -1 if its sprite is
+    // not in the catalog.
+    int SpriteId() const;
     // Get this object's position on the date most recently passed to this
     // system's SetDate() function.
     const QVector2D &Position() const;
@@ -50,18 +54,27 @@ public:
     // Get the index of the parent object.
     int Parent() const;
 
+    // Each of these picks a sprite that is not in the given set of used
+    // sprites, unless all sprites of that kind are already used. Sprites in
+    // the forbidden set are never picked.
     // Get a random star, based on a probability distribution of stars.
-    static StellarObject Star();
+    static StellarObject Star(const SpriteCatalog::Set &used = SpriteCatalog::Set(),
+        const SpriteCatalog::Set &forbidden = SpriteCatalog::Set());
     // Get a random "moon." It may also be used as a stand-alone planet.
-    static StellarObject Moon();
+    static StellarObject Moon(const SpriteCatalog::Set &used = SpriteCatalog::Set(),
+        const SpriteCatalog::Set &forbidden = SpriteCatalog::Set());
     // Get a random (non-giant) planet. It may or may not be habitable.
-    static StellarObject Planet();
+    static StellarObject Planet(const SpriteCatalog::Set &used = SpriteCatalog::Set(),
+        const SpriteCatalog::Set &forbidden = SpriteCatalog::Set());
     // Get a random planet that can exist outside the habitable zone.
-    static StellarObject Uninhabited();
+    static StellarObject Uninhabited(const SpriteCatalog::Set &used = SpriteCatalog::Set(),
+        const SpriteCatalog::Set &forbidden = SpriteCatalog::Set());
     // Get a random gas giant.
-    static StellarObject Giant();
+    static StellarObject Giant(const SpriteCatalog::Set &used = SpriteCatalog::Set(),
+        const SpriteCatalog::Set &forbidden = SpriteCatalog::Set());
     // Get a random station.
-    static StellarObject Station();
+    static StellarObject Station(const SpriteCatalog::Set &used = SpriteCatalog::Set(),
+        const SpriteCatalog::Set &forbidden = SpriteCatalog::Set());
 
     // Check if this is a star.
     bool IsStar() const;
@@ -80,11 +93,15 @@ public:
 
 
 private:
-    static StellarObject Planet(int minRadius, int maxRadius = 1000, bool skipHabitable = false);
+    // Set the sprite, and look it up in the catalog.
+    void SetSprite(const QString &name);
+
+    static StellarObject Pick(SpriteCatalog::Category category, const SpriteCatalog::Set &used, const SpriteCatalog::Set &forbidden);
 
 
 private:
     QString sprite;
+    int spriteId = -1;
 
     QVector2D position;
     QString planet;
@@ -14,8 +14,8 @@ PARTICULAR PURPOSE.  See the GNU General Public License for more details.
 
 #include "DataNode.h"
 #include "DataWriter.h"
-#include "pi.h"
 #include "Planet.h"
+#include "Random.h"
 
 #include <QString>
 
@@ -37,6 +37,20 @@ namespace {
 
     static const int RANDOM_STAR_DISTANCE = 40;
     static const double MIN_STAR_DISTANCE = 40.;
+
+    // Get the farthest out that the given number of moons might reach, as
+    // placed by System::AddPlanet(), around a planet of the given radius.
+    double MaxMoonDistance(double radius, int moonCount)
+    {
+        double distance = radius;
+        int randomMoonSpace = RANDOM_MOON_GAP;
+        for(int i = 0; i < moonCount; ++i)
+        {
+            distance += (randomMoonSpace - 1) + MIN_MOON_GAP + 2. * SpriteCatalog::MOON_RADIUS;
+            randomMoonSpace += 20;
+        }
+        return distance;
+    }
 }
 
 
@@ -144,6 +158,13 @@ const QString &System::Government() const
 
 
 
+unsigned System::Generation() const
+{
+    return generation;
+}
+
+
+
 // Get a list of systems you can travel to through hyperspace from here.
 const set<QString> &System::Links() const
 {
@@ -181,17 +202,12 @@ double System::HabitableZone() const
 // object is in orbit around something else, this function returns 0.
 double System::OccupiedRadius(const StellarObject &object) const
 {
-    // Make sure the object is part of this system and is a primary object.
-    if(&object < &objects.front() || &object > &objects.back() || object.Parent() >= 0 || object.IsStar())
+    // Make sure the object is part of this system.
+    if(objects.empty() || &object < &objects.front() || &object > &objects.back())
         return 0.;
 
-    double radius = object.Radius();
-    int index = &object - &objects.front();
-    for(const StellarObject &other : objects)
-        if(other.Parent() == index)
-            radius = max(radius, other.Distance() + other.Radius());
-
-    return radius;
+    UpdateRadii();
+    return occupied[&object - &objects.front()];
 }
 
 
@@ -212,14 +228,8 @@ double System::OccupiedRadius() const
 
 double System::StarRadius() const
 {
-    double radius = 0.;
-    for(const StellarObject &other : objects)
-    {
-        if(!other.IsStar())
-            break;
-        radius = max(radius, other.Distance() + other.Radius());
-    }
-    return radius;
+    UpdateRadii();
+    return starRadius;
 }
 
 
@@ -274,18 +284,17 @@ const vector<System::Fleet> &System::Fleets() const
 void System::SetDay(double day)
 {
     timeStep = day;
-    for(StellarObject &object : objects)
+    if(orbitGeneration != generation || orbits.Size() != objects.size())
     {
-        double angle = (!object.period ? 0. : day * 360. / object.period) + object.offset;
-        angle *= TO_RAD;
-
-        object.position = object.distance * QVector2D(sin(angle), -cos(angle));
-
-        // Because of the order of the vector, the parent's position has always
-        // been updated before this loop reaches any of its children, so:
-        if(object.parent >= 0)
-            object.position += objects[object.parent].position;
+        orbits.Clear();
+        for(const StellarObject &object : objects)
+            orbits.Add(object.distance, object.period, object.offset, object.parent);
+        orbitGeneration = generation;
     }
+
+    orbits.SetDay(day);
+    for(size_t i = 0; i < objects.size(); ++i)
+        objects[i].position = orbits.Position(i);
 }
 
 
@@ -295,6 +304,7 @@ void System::LoadObject(const DataNode &node, int parent)
     int index = static_cast<int>(objects.size());
 
     objects.emplace_back(parent);
+    radiiAreCurrent = false;
     StellarObject &object = objects.back();
 
     if(node.Size() >= 2)
@@ -303,7 +313,7 @@ void System::LoadObject(const DataNode &node, int parent)
     for(const DataNode &child : node)
     {
         if(child.Token(0) == "sprite" && child.Size() >= 2)
-            object.sprite = child.Token(1);
+            object.SetSprite(child.Token(1));
         else if(child.Token(0) == "distance" && child.Size() >= 2)
             object.distance = child.Value(1);
         else if(child.Token(0) == "period" && child.Size() >= 2)
@@ -367,6 +377,7 @@ void System::Init(const QString &name, const QVector2D &position)
 
 void System::SetName(const QString &name)
 {
+    ++generation;
     this->name = name;
 }
 
@@ -374,6 +385,7 @@ void System::SetName(const QString &name)
 
 void System::SetPosition(const QVector2D &pos)
 {
+    ++generation;
     position = pos;
 }
 
@@ -381,6 +393,7 @@ void System::SetPosition(const QVector2D &pos)
 
 void System::SetGovernment(const QString &gov)
 {
+    ++generation;
     government = gov;
 }
 
@@ -392,6 +405,8 @@ void System::ToggleLink(System *other)
     if(!other || other == this)
         return;
 
+    ++generation;
+    ++other->generation;
     if(links.erase(other->name))
         other->links.erase(name);
     else
@@ -408,6 +423,7 @@ void System::ToggleLink(System *other)
 // effectively deletes the link.
 void System::ChangeLink(const QString &from, const QString &to)
 {
+    ++generation;
     if(links.erase(from) && !to.isEmpty())
         links.emplace(to);
 }
@@ -416,6 +432,7 @@ void System::ChangeLink(const QString &from, const QString &to)
 
 void System::SetTrade(const QString &commodity, int value)
 {
+    ++generation;
     trade[commodity] = value;
 }
 
@@ -426,6 +443,8 @@ void System::Move(StellarObject *object, double dDistance, double dAngle)
     if(!object || !object->period || object->IsStar())
         return;
 
+    ++generation;
+
     // Find the next object in from this object. Determine what the orbital
     // radius of that object is. Don't allow objects too close together.
     auto it = objects.begin() + (object - &objects.front());
@@ -478,16 +497,17 @@ void System::Move(StellarObject *object, double dDistance, double dAngle)
 
 void System::ChangeAsteroids()
 {
+    ++generation;
     asteroids.clear();
 
     // Pick the total number of asteroids. Bias towards small numbers, with
     // a few systems with many more.
-    int fullTotal = (rand() % 21) * (rand() % 21) + 1;
-    double energy = (rand() % 21 + 10) * (rand() % 21 + 10) * .01;
+    int fullTotal = Random::Local().Int(21) * Random::Local().Int(21) + 1;
+    double energy = (Random::Local().Int(21) + 10) * (Random::Local().Int(21) + 10) * .01;
     const QString suffix[2] = {" rock", " metal"};
     const QString prefix[3] = {"small", "medium", "large"};
 
-    int total[2] = {rand() % fullTotal, 0};
+    int total[2] = {Random::Local().Int(fullTotal), 0};
     total[1] = fullTotal - total[0];
 
     for(int i = 0; i < 2; ++i)
@@ -495,11 +515,11 @@ void System::ChangeAsteroids()
         if(!total[i])
             continue;
 
-        int count[3] = {0, rand() % total[i], 0};
+        int count[3] = {0, Random::Local().Int(total[i]), 0};
         int remaining = total[i] - count[1];
         if(remaining)
         {
-            count[0] = rand() % remaining;
+            count[0] = Random::Local().Int(remaining);
             count[2] = remaining - count[0];
         }
 
@@ -508,7 +528,7 @@ void System::ChangeAsteroids()
                 asteroids.emplace_back(
                     prefix[j] + suffix[i],
                     count[j],
-                    energy * (rand() % 101 + 50) * .01);
+                    energy * (Random::Local().Int(101) + 50) * .01);
     }
 }
 
@@ -516,8 +536,9 @@ void System::ChangeAsteroids()
 
 void System::ChangeMinables()
 {
+    ++generation;
     // First, change the belt radius.
-    belt = rand() % 1000 + 1000;
+    belt = Random::Local().Int(1000) + 1000;
     minables.clear();
     
     // Next, figure out the quantity and energy of the ordinary asteroids.
@@ -555,11 +576,11 @@ void System::ChangeMinables()
     for(int i = 0; i < 3; ++i)
     {
         // Pick three random minable types, with decreasing quantities.
-        totalCount = rand() % (totalCount + 1);
+        totalCount = Random::Local().Int(totalCount + 1);
         if(!totalCount)
             break;
         
-        int choice = rand() % 100;
+        int choice = Random::Local().Int(100);
         for(const auto &it : probability)
         {
             choice -= it.second;
@@ -572,7 +593,7 @@ void System::ChangeMinables()
     }
     for(const auto &it : choices)
     {
-        double energy = (rand() % 1000 + 1000) * .001 * meanEnergy;
+        double energy = (Random::Local().Int(1000) + 1000) * .001 * meanEnergy;
         minables.emplace_back(it.first, it.second, energy);
     }
 }
@@ -581,6 +602,7 @@ void System::ChangeMinables()
 
 void System::ChangeStar()
 {
+    ++generation;
     double oldStarRadius = StarRadius();
     unsigned oldStars = 0;
     while(!objects.empty() && objects.front().IsStar())
@@ -590,7 +612,7 @@ void System::ChangeStar()
     }
 
     // If the number of stars is changing, all parent indices change.
-    unsigned stars = 1 + !(rand() % 3);
+    unsigned stars = 1 + !Random::Local().Int(3);
     if(stars != oldStars)
         for(StellarObject &object : objects)
             if(object.parent >= 0)
@@ -618,7 +640,7 @@ void System::ChangeStar()
         double secondMass = pow(secondR, 3.) * STAR_MASS_SCALE;
         mass = firstMass + secondMass;
 
-        double distance = firstR + secondR + (rand() % RANDOM_STAR_DISTANCE) + MIN_STAR_DISTANCE;
+        double distance = firstR + secondR + Random::Local().Int(RANDOM_STAR_DISTANCE) + MIN_STAR_DISTANCE;
         // m1 * d1 = m2 * d2
         // d1 + d2 = d;
         // m1 * d1 = m2 * (d - d1)
@@ -637,6 +659,7 @@ void System::ChangeStar()
         objects.insert(objects.begin(), (firstD < secondD) ? first : second);
     }
     habitable = mass / HABITABLE_SCALE;
+    radiiAreCurrent = false;
 
     if(objects.size() > stars)
     {
@@ -652,28 +675,32 @@ void System::ChangeSprite(StellarObject *object)
     if(!object || object < &objects.front() || object > &objects.back())
         return;
 
+    ++generation;
+
+    // The object's current sprite is in the used set, so a different one will
+    // be picked if there is any other sprite of the same kind.
     StellarObject newObject;
-    set<QString> used = Used();
-    do {
-        if(object->IsStation())
-            newObject = StellarObject::Station();
-        else if(object->IsMoon())
-            newObject = StellarObject::Moon();
-        else if(object->IsGiant())
-            newObject = StellarObject::Giant();
+    SpriteCatalog::Set used = Used();
+    if(object->IsStation())
+        newObject = StellarObject::Station(used);
+    else if(object->IsMoon())
+        newObject = StellarObject::Moon(used);
+    else if(object->IsGiant())
+        newObject = StellarObject::Giant(used);
+    else
+    {
+        double distance = (object->Parent() >= 0 ? objects[object->Parent()].Distance() : object->Distance());
+        if(distance >= .5 * habitable && distance < 2. * habitable)
+            newObject = StellarObject::Planet(used);
         else
-        {
-            double distance = (object->Parent() >= 0 ? objects[object->Parent()].Distance() : object->Distance());
-            if(distance >= .5 * habitable && distance < 2. * habitable)
-                newObject = StellarObject::Planet();
-            else
-                newObject = StellarObject::Uninhabited();
-        }
-    } while(used.count(newObject.Sprite()));
+            newObject = StellarObject::Uninhabited(used);
+    }
 
     // Check how much the radius will change by, then change the sprite.
     double radiusChange = newObject.Radius() - object->Radius();
     object->sprite = newObject.sprite;
+    object->spriteId = newObject.spriteId;
+    radiiAreCurrent = false;
 
     // If this object has a parent:
     // this distance += dRadius
@@ -726,66 +753,7 @@ void System::ChangeSprite(StellarObject *object)
 
 void System::AddPlanet()
 {
-    // The spacing between planets grows exponentially.
-    int randomPlanetSpace = RANDOM_GAP;
-    for(const StellarObject &object : objects)
-        if(!object.IsStar() && object.Parent() < 0)
-            randomPlanetSpace += randomPlanetSpace / 2;
-
-    double distance = OccupiedRadius();
-    int space = rand() % randomPlanetSpace;
-    distance += (space * space) * .01 + MIN_GAP;
-
-    set<QString> used = Used();
-
-    StellarObject root;
-    int rootIndex = (int)objects.size();
-
-    bool isHabitable = (distance > habitable * .5 && distance < habitable * 2. - 120.);
-    bool isSmall = !(rand() % 10);
-    bool isTerrestrial = !isSmall && (rand() % 2000 > distance);
-
-    // Occasionally, moon-sized objects can be root objects. Otherwise, pick a
-    // giant or a normal planet, with giants more frequent in the outer parts
-    // of the solar system.
-    do {
-        if(isSmall)
-            root = StellarObject::Moon();
-        else if(isTerrestrial)
-            root = isHabitable ? StellarObject::Planet() : StellarObject::Uninhabited();
-        else
-            root = StellarObject::Giant();
-    } while(used.count(root.Sprite()));
-    objects.push_back(root);
-    used.insert(root.Sprite());
-
-    int moonCount = rand() % (isTerrestrial ? (rand() % 2 + 1) : (rand() % 3 + 3));
-    if(root.Radius() < 70)
-        moonCount = 0;
-
-    double moonDistance = root.Radius();
-    int randomMoonSpace = RANDOM_MOON_GAP;
-    for(int i = 0; i < moonCount; ++i)
-    {
-        moonDistance += rand() % randomMoonSpace + MIN_MOON_GAP;
-        // Each moon, on average, should be spaced more widely than the one before.
-        randomMoonSpace += 20;
-
-        // Use a moon sprite only once per system.
-        StellarObject moon;
-        do {
-            moon = StellarObject::Moon();
-        } while(used.count(moon.Sprite()));
-        used.insert(moon.Sprite());
-
-        moon.distance = moonDistance + moon.Radius();
-        moon.parent = rootIndex;
-        Recompute(moon, false);
-        objects.push_back(moon);
-        moonDistance += 2. * moon.Radius();
-    }
-    objects[rootIndex].distance = distance + moonDistance;
-    Recompute(objects[rootIndex], false);
+    AddPlanet(SpriteCatalog::Set(), false);
 }
 
 
@@ -795,6 +763,8 @@ void System::AddMoon(StellarObject *object, bool isStation)
     if(!object || object < &objects.front() || object > &objects.back())
         return;
 
+    ++generation;
+
     double originalMoonDistance = object->Radius();
     int randomMoonSpace = RANDOM_MOON_GAP;
     int rootIndex = object - &objects.front();
@@ -806,12 +776,9 @@ void System::AddMoon(StellarObject *object, bool isStation)
         ++it;
     }
 
-    double moonDistance = originalMoonDistance + rand() % randomMoonSpace + MIN_MOON_GAP;
-    set<QString> used = Used();
-    StellarObject moon;
-    do {
-        moon = isStation ? StellarObject::Station() : StellarObject::Moon();
-    } while(used.count(moon.Sprite()));
+    double moonDistance = originalMoonDistance + Random::Local().Int(randomMoonSpace) + MIN_MOON_GAP;
+    SpriteCatalog::Set used = Used();
+    StellarObject moon = isStation ? StellarObject::Station(used) : StellarObject::Moon(used);
 
     moon.distance = moonDistance + moon.Radius();
     moon.parent = rootIndex;
@@ -829,6 +796,7 @@ void System::AddMoon(StellarObject *object, bool isStation)
     // Insert the new moon, then update the parent indices of all moons farther
     // out than this one (because their parents' indices have changed).
     it = objects.insert(it, moon);
+    radiiAreCurrent = false;
     for( ; it != objects.end(); ++it)
         if(it->parent > rootIndex)
             ++it->parent;
@@ -836,30 +804,32 @@ void System::AddMoon(StellarObject *object, bool isStation)
 
 
 
+// Build the system outward from the star, as AddPlanet() would. Any
+// requirements are met while the planets are placed: inhabited sprites are
+// never picked if they are not allowed, and if a habitable planet is needed,
+// the first planet that reaches the habitable zone (or that might leave no
+// room for one there) is made into one.
 void System::Randomize(bool allowHabitable, bool requireHabitable)
 {
-    // Try to create a system satisfying the given parameters.
-    for(int i = 0; i < 100; ++i)
+    ++generation;
+    objects.clear();
+    ChangeStar();
+
+    SpriteCatalog::Set forbidden;
+    if(!allowHabitable)
+        forbidden = SpriteCatalog::Inhabited();
+
+    // If the stars are so bright that the habitable zone is beyond where the
+    // planets would normally stop, keep adding planets until it is reached.
+    bool needsHabitable = requireHabitable;
+    while(OccupiedRadius() < 2000. || needsHabitable)
     {
-        objects.clear();
-        ChangeStar();
-        while(OccupiedRadius() < 2000.)
-            AddPlanet();
-
-        bool isInhabited = false;
-        bool isHabitable = false;
-        for(const StellarObject &object : objects)
-        {
-            isInhabited |= object.IsInhabited();
-            double d = object.Distance();
-            isHabitable |= object.Parent() < 0 && object.IsTerrestrial()
-                && d > .5 * habitable && d < 2. * habitable;
-        }
-        if(isInhabited && !allowHabitable)
-            continue;
-        if(!isHabitable && requireHabitable)
-            continue;
-        break;
+        if(AddPlanet(forbidden, needsHabitable))
+            needsHabitable = false;
+        // Give up on a habitable planet once the zone is behind us. This only
+        // happens if the stars leave no room for a planet inside the zone.
+        if(OccupiedRadius() >= 2. * habitable)
+            needsHabitable = false;
     }
 }
 
@@ -874,6 +844,8 @@ void System::Delete(StellarObject *object)
     if(index < 0 || static_cast<unsigned>(index) >= objects.size())
         return;
 
+    ++generation;
+
     double shrink = object->Radius();
 
     auto it = objects.begin() + index;
@@ -885,6 +857,7 @@ void System::Delete(StellarObject *object)
     }
     int parentShift = end - it;
     objects.erase(it, end);
+    radiiAreCurrent = false;
 
     it = objects.begin() + index;
     if(it == objects.end())
@@ -898,8 +871,10 @@ void System::Delete(StellarObject *object)
 
 
 
+// This is called whenever an object's distance changes.
 void System::Recompute(StellarObject &object, bool updateOffset)
 {
+    radiiAreCurrent = false;
     double mass = habitable * HABITABLE_SCALE;
     if(object.Parent() >= 0.)
         mass = pow(objects[object.Parent()].Radius(), 3.) * PLANET_MASS_SCALE;
@@ -916,10 +891,134 @@ void System::Recompute(StellarObject &object, bool updateOffset)
 
 
 
-set<QString> System::Used() const
+// Add a planet beyond all the objects in this system, never using a sprite in
+// the given set. If a habitable planet is still needed, this planet may be made
+// into one; the return value says whether the planet that was added is
+// terrestrial and in the habitable zone.
+bool System::AddPlanet(const SpriteCatalog::Set &forbidden, bool needsHabitable)
 {
-    set<QString> used;
+    ++generation;
+    // The spacing between planets grows exponentially.
+    int randomPlanetSpace = RANDOM_GAP;
     for(const StellarObject &object : objects)
-        used.insert(object.Sprite());
+        if(!object.IsStar() && object.Parent() < 0)
+            randomPlanetSpace += randomPlanetSpace / 2;
+
+    const double minDistance = OccupiedRadius() + MIN_GAP;
+    int space = Random::Local().Int(randomPlanetSpace);
+    double distance = minDistance + (space * space) * .01;
+
+    SpriteCatalog::Set used = Used();
+
+    StellarObject root;
+    int rootIndex = (int)objects.size();
+
+    bool isHabitable = (distance > habitable * .5 && distance < habitable * 2. - 120.);
+    bool isSmall = !Random::Local().Int(10);
+    bool isTerrestrial = !isSmall && (Random::Local().Int(2000) > distance);
+
+    // Occasionally, moon-sized objects can be root objects. Otherwise, pick a
+    // giant or a normal planet, with giants more frequent in the outer parts
+    // of the solar system.
+    if(isSmall)
+        root = StellarObject::Moon(used, forbidden);
+    else if(isTerrestrial)
+        root = isHabitable ? StellarObject::Planet(used, forbidden) : StellarObject::Uninhabited(used, forbidden);
+    else
+        root = StellarObject::Giant(used, forbidden);
+
+    int moonCount = Random::Local().Int(isTerrestrial ? (Random::Local().Int(2) + 1) : (Random::Local().Int(3) + 3));
+    if(root.Radius() < 70)
+        moonCount = 0;
+
+    // If this planet starts past the inner edge of the habitable zone, or if
+    // it might reach out so far that a terrestrial planet beyond it could not
+    // be inside the zone, it must be the habitable planet.
+    bool makeHabitable = needsHabitable && (distance >= .5 * habitable
+        || distance + 2. * MaxMoonDistance(root.Radius(), moonCount) + 2. * MIN_GAP
+            + SpriteCatalog::GIANT_RADIUS > 2. * habitable);
+    if(makeHabitable)
+    {
+        root = StellarObject::Planet(used, forbidden);
+        moonCount = Random::Local().Int(Random::Local().Int(2) + 1);
+        // Leave out the moon if there is no room for it.
+        if(root.Radius() < 70 || minDistance + MaxMoonDistance(root.Radius(), moonCount) > 2. * habitable - MIN_GAP)
+            moonCount = 0;
+    }
+    objects.push_back(root);
+    if(root.SpriteId() >= 0)
+        used.set(root.SpriteId());
+
+    double moonDistance = root.Radius();
+    int randomMoonSpace = RANDOM_MOON_GAP;
+    for(int i = 0; i < moonCount; ++i)
+    {
+        moonDistance += Random::Local().Int(randomMoonSpace) + MIN_MOON_GAP;
+        // Each moon, on average, should be spaced more widely than the one before.
+        randomMoonSpace += 20;
+
+        // Use a moon sprite only once per system.
+        StellarObject moon = StellarObject::Moon(used, forbidden);
+        if(moon.SpriteId() >= 0)
+            used.set(moon.SpriteId());
+
+        moon.distance = moonDistance + moon.Radius();
+        moon.parent = rootIndex;
+        Recompute(moon, false);
+        objects.push_back(moon);
+        moonDistance += 2. * moon.Radius();
+    }
+
+    // Move the habitable planet into the zone if it is not in it already, but
+    // never closer in than the minimum gap.
+    if(makeHabitable)
+    {
+        double center = distance + moonDistance;
+        center = max(.5 * habitable + MIN_GAP, min(center, 2. * habitable - MIN_GAP));
+        distance = max(minDistance, center - moonDistance);
+    }
+    objects[rootIndex].distance = distance + moonDistance;
+    Recompute(objects[rootIndex], false);
+
+    double d = objects[rootIndex].Distance();
+    return objects[rootIndex].IsTerrestrial() && d > .5 * habitable && d < 2. * habitable;
+}
+
+
+
+SpriteCatalog::Set System::Used() const
+{
+    SpriteCatalog::Set used;
+    for(const StellarObject &object : objects)
+        if(object.SpriteId() >= 0)
+            used.set(object.SpriteId());
     return used;
 }
+
+
+
+void System::UpdateRadii() const
+{
+    if(radiiAreCurrent)
+        return;
+
+    // Moons always come after the object they orbit, so one pass finds the
+    // farthest extent of each object's moons. Only primary objects other than
+    // the stars occupy a zone of their own.
+    occupied.assign(objects.size(), 0.);
+    starRadius = 0.;
+    bool isStar = true;
+    for(size_t i = 0; i < objects.size(); ++i)
+    {
+        const StellarObject &object = objects[i];
+        isStar &= object.IsStar();
+        double radius = object.Radius();
+        if(isStar)
+            starRadius = max(starRadius, object.Distance() + radius);
+        else if(object.Parent() < 0)
+            occupied[i] = object.IsStar() ? 0. : radius;
+        else if(!objects[object.Parent()].IsStar() && objects[object.Parent()].Parent() < 0)
+            occupied[object.Parent()] = max(occupied[object.Parent()], object.Distance() + radius);
+    }
+    radiiAreCurrent = true;
+}
@@ -13,6 +13,7 @@ PARTICULAR PURPOSE.  See the GNU General Public License for more details.
 #ifndef SYSTEM_H_
 #define SYSTEM_H_
 
+#include "Orbits.h"
 #include "StellarObject.h"
 
 #include <QVector2D>
@@ -58,6 +59,9 @@ public:
     const QVector2D &Position() const;
     // Get this system's government.
     const QString &Government() const;
+    // Get a counter that changes every time this system is modified through
+    // one of the functions below, so views can tell if what they show is stale.
+    unsigned Generation() const;
 
     // Get a list of systems you can travel to through hyperspace from here.
     const std::set<QString> &Links() const;
@@ -116,8 +120,12 @@ private:
     void LoadObject(const DataNode &node, int parent = -1);
     void SaveObject(DataWriter &file, const StellarObject &object) const;
     void Recompute(StellarObject &object, bool updateOffset = true);
-    // Get a list of all sprites that are in use already.
-    std::set<QString> Used() const;
+    bool AddPlanet(const SpriteCatalog::Set &forbidden, bool needsHabitable);
+    // Get the set of catalog sprites that are in use already.
+    SpriteCatalog::Set Used() const;
+    // Recompute the cached radii, if any object has been added, removed,
+    // resized, or moved since they were computed.
+    void UpdateRadii() const;
 
 
 private:
@@ -147,7 +155,18 @@ private:
     std::list<DataNode> unparsed;
 
     // Keep track of the current time step.
-    double timeStep;
+    double timeStep = 0.;
+    // Copy of the objects' orbital parameters, laid out for computing their
+    // positions quickly. It is rebuilt if the system has been modified since
+    // it was made.
+    Orbits orbits;
+    unsigned orbitGeneration = ~0u;
+    // Cached radius occupied by each object and its moons, and by the stars.
+    mutable std::vector<double> occupied;
+    mutable double starRadius = 0.;
+    mutable bool radiiAreCurrent = false;
+
+    unsigned generation = 0;
 };
 
 
@@ -16,10 +16,12 @@ PARTICULAR PURPOSE.  See the GNU General Public License for more details.
 #include "Map.h"
 #include "pi.h"
 #include "PlanetView.h"
+#include "SpriteQueue.h"
 #include "SpriteSet.h"
 #include "StellarObject.h"
 #include "System.h"
 
+#include <QPaintEvent>
 #include <QPainter>
 #include <QPainterPath>
 #include <QPalette>
@@ -43,6 +45,7 @@ SystemView::SystemView(Map &mapData, DetailView *detailView, QTabWidget *tabs, Q
     setPalette(p);
 
     connect(&timer, SIGNAL(timeout()), this, SLOT(step()));
+    connect(&SpriteQueue::Instance(), SIGNAL(Loaded(const QString &)), this, SLOT(update()));
     timer.start(1000. / 60.);
 }
 
@@ -56,7 +59,13 @@ void SystemView::Select(System *system)
     this->system = system;
     asteroids.Set(system);
     if(system)
+    {
         system->SetDay(timeStep);
+        // Start loading the sprites, so they are ready when this view is shown.
+        for(const StellarObject &object : system->Objects())
+            if(!object.Sprite().isEmpty())
+                SpriteSet::Preload(object.Sprite());
+    }
 
     selectedObject = nullptr;
 }
@@ -159,7 +168,7 @@ void SystemView::ChangeMinables()
     {
         system->ChangeMinables();
         asteroids.Set(system);
-        detailView->UpdateMinables();
+        mapData.Notify(Map::Change(Map::Change::MINABLES_CHANGED, system));
         DidChange();
     }
 }
@@ -270,8 +279,8 @@ void SystemView::mousePressEvent(QMouseEvent *event)
     // Right- and middle-clicking deselects.
     if(event->button() != Qt::LeftButton)
     {
+        update(SelectionRect());
         selectedObject = nullptr;
-        update();
         return;
     }
     else if(!system)
@@ -286,10 +295,11 @@ void SystemView::mousePressEvent(QMouseEvent *event)
         {
             // Correct the click position to the object's initial position.
             dragTime.start();
+            update(SelectionRect());
             selectedObject = dragObject = &object;
+            update(SelectionRect());
             clickOff = object.Position() - pos;
             planetView->SetPlanet(&object);
-            update();
             return;
         }
 }
@@ -347,7 +357,7 @@ void SystemView::mouseMoveEvent(QMouseEvent *event)
 
         system->Move(dragObject, newRadius - oldRadius, (newAngle - oldAngle) * TO_DEG);
         system->SetDay(timeStep);
-        mapData.SetChanged();
+        mapData.Notify(Map::Change(Map::Change::OBJECTS_CHANGED, system));
     }
     if(isPaused)
         update();
@@ -375,7 +385,7 @@ void SystemView::wheelEvent(QWheelEvent *event)
 
 
 
-void SystemView::paintEvent(QPaintEvent */*event*/)
+void SystemView::paintEvent(QPaintEvent *event)
 {
     if(!system)
         return;
@@ -445,21 +455,34 @@ void SystemView::paintEvent(QPaintEvent */*event*/)
         painter.drawLine(object.Position().toPointF(), parent);
     }
 
+    // Get the part of the map that needs to be repainted.
+    QVector2D origin = QVector2D(.5 * width(), .5 * height()) + offset;
+    QRectF dirty(((QVector2D(event->rect().topLeft()) - origin) / scale).toPointF(),
+        ((QVector2D(event->rect().bottomRight()) - origin) / scale).toPointF());
+
     QPen blue(QColor(0, 128, 255));
     blue.setWidthF(2.5);
     painter.setPen(blue);
     painter.setBrush(Qt::NoBrush);
     for(const StellarObject &object : system->Objects())
     {
-        QPixmap sprite = SpriteSet::Get(object.Sprite());
+        // Draw a downscaled copy of the sprite when zoomed out, stretched to
+        // the full-size sprite's bounds.
+        QSizeF size = SpriteSet::Get(object.Sprite()).size();
+        QPixmap sprite = SpriteSet::Get(object.Sprite(), scale);
         QVector2D pos = object.Position();
+        // Skip objects that are entirely outside the repainted area.
+        double reach = max(.5 * hypot(size.width(), size.height()), object.Radius() + 5.);
+        if(!dirty.intersects(QRectF(pos.x() - reach, pos.y() - reach, 2. * reach, 2. * reach)))
+            continue;
         double angle = pos.isNull() ? (-2. * PI * timeStep / object.Period()) : atan2(pos.x(), pos.y());
         angle *= TO_DEG;
         angle += 180.;
 
         painter.translate(pos.toPointF());
         painter.rotate(-angle);
-        painter.drawPixmap(QPointF(-.5 * sprite.width(), -.5 * sprite.height()), sprite);
+        painter.drawPixmap(QRectF(QPointF(-.5 * size.width(), -.5 * size.height()), size),
+            sprite, QRectF(sprite.rect()));
         painter.rotate(angle);
         painter.translate(-pos.toPointF());
         if(!object.GetPlanet().isEmpty())
@@ -468,10 +491,7 @@ void SystemView::paintEvent(QPaintEvent */*event*/)
             painter.drawEllipse(pos.toPointF(), radius, radius);
         }
     }
-    // Get the bounding box of the paint region after scaling and offset.
-    QVector2D half(.5 * width() / scale, .5 * height() / scale);
-    QRectF bounds((offset / -scale - half).toPointF(), (offset / -scale + half).toPointF());
-    asteroids.Draw(painter, bounds);
+    asteroids.Draw(painter, dirty);
 
     if(selectedObject)
     {
@@ -497,10 +517,23 @@ QVector2D SystemView::MapPoint(QPoint pos) const
 
 
 
+// Get the screen area covered by the selected object's highlight circle.
+QRect SystemView::SelectionRect() const
+{
+    if(!selectedObject)
+        return QRect();
+
+    QVector2D center = QVector2D(.5 * width(), .5 * height()) + offset + selectedObject->Position() * scale;
+    double radius = (selectedObject->Radius() + 10.) * scale + 2.;
+    return QRectF(center.x() - radius, center.y() - radius, 2. * radius, 2. * radius).toAlignedRect();
+}
+
+
+
 // If a method did something, this updates the map, date, and draw window.
 void SystemView::DidChange()
 {
     system->SetDay(timeStep);
-    mapData.SetChanged();
+    mapData.Notify(Map::Change(Map::Change::OBJECTS_CHANGED, system));
     update();
 }
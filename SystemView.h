@@ -72,6 +72,7 @@ protected:
 
 private:
     QVector2D MapPoint(QPoint pos) const;
+    QRect SelectionRect() const;
     void DidChange();
 
 
@@ -0,0 +1,125 @@
+/* ThumbnailCache.cpp
+Copyright (c) 2015 by Michael Zahniser
+
+Endless Sky is free software: you can redistribute it and/or modify it under the
+terms of the GNU General Public License as published by the Free Software
+Foundation, either version 3 of the License, or (at your option) any later version.
+
+Endless Sky is distributed in the hope that it will be useful, but WITHOUT ANY
+WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A
+PARTICULAR PURPOSE.  See the GNU General Public License for more details.
+*/
+
+#include "ThumbnailCache.h"
+
+#include <QDataStream>
+#include <QDateTime>
+#include <QDir>
+#include <QFile>
+#include <QFileInfo>
+#include <QSaveFile>
+#include <QStandardPaths>
+
+using namespace std;
+
+namespace {
+    // The file starts with these, so that a file in some other format (or
+    // an older version of this one) is ignored instead of misread.
+    const quint32 MAGIC = 0x45534C54;
+    const quint32 VERSION = 1;
+
+    QString CachePath()
+    {
+        return QStandardPaths::writableLocation(QStandardPaths::CacheLocation) + "/thumbnails.dat";
+    }
+}
+
+
+
+void ThumbnailCache::Load()
+{
+    entries.clear();
+    isChanged = false;
+
+    QFile file(CachePath());
+    if(!file.open(QIODevice::ReadOnly))
+        return;
+
+    QDataStream in(&file);
+    in.setVersion(QDataStream::Qt_5_0);
+    quint32 magic = 0;
+    quint32 version = 0;
+    quint32 count = 0;
+    in >> magic >> version >> count;
+    if(magic != MAGIC || version != VERSION)
+        return;
+
+    for(quint32 i = 0; i < count && in.status() == QDataStream::Ok; ++i)
+    {
+        QString path;
+        Entry entry;
+        in >> path >> entry.modified >> entry.size >> entry.image;
+        if(in.status() == QDataStream::Ok)
+            entries[path] = entry;
+    }
+}
+
+
+
+void ThumbnailCache::Save()
+{
+    // Forget any images that have been removed.
+    for(auto it = entries.begin(); it != entries.end(); )
+    {
+        if(QFileInfo::exists(it->first))
+            ++it;
+        else
+        {
+            it = entries.erase(it);
+            isChanged = true;
+        }
+    }
+    if(!isChanged)
+        return;
+
+    QString path = CachePath();
+    QDir().mkpath(QFileInfo(path).absolutePath());
+    // Write to a temporary file, so a crash never leaves a truncated cache.
+    QSaveFile file(path);
+    if(!file.open(QIODevice::WriteOnly))
+        return;
+
+    QDataStream out(&file);
+    out.setVersion(QDataStream::Qt_5_0);
+    out << MAGIC << VERSION << static_cast<quint32>(entries.size());
+    for(const auto &it : entries)
+        out << it.first << it.second.modified << it.second.size << it.second.image;
+    if(file.commit())
+        isChanged = false;
+}
+
+
+
+QImage ThumbnailCache::Get(const QFileInfo &file) const
+{
+    auto it = entries.find(file.absoluteFilePath());
+    if(it == entries.end())
+        return QImage();
+
+    const Entry &entry = it->second;
+    if(entry.modified != file.lastModified().toMSecsSinceEpoch() || entry.size != file.size())
+        return QImage();
+
+    return entry.image;
+}
+
+
+
+void ThumbnailCache::Set(const QFileInfo &file, const QImage &thumbnail)
+{
+    Entry &entry = entries[file.absoluteFilePath()];
+    entry.modified = file.lastModified().toMSecsSinceEpoch();
+    entry.size = file.size();
+    entry.image = thumbnail;
+    isChanged = true;
+}
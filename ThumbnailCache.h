@@ -0,0 +1,59 @@
+/* ThumbnailCache.h
+Copyright (c) 2015 by Michael Zahniser
+
+Endless Sky is free software: you can redistribute it and/or modify it under the
+terms of the GNU General Public License as published by the Free Software
+Foundation, either version 3 of the License, or (at your option) any later version.
+
+Endless Sky is distributed in the hope that it will be useful, but WITHOUT ANY
+WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A
+PARTICULAR PURPOSE.  See the GNU General Public License for more details.
+*/
+
+#ifndef THUMBNAILCACHE_H
+#define THUMBNAILCACHE_H
+
+#include <QImage>
+#include <QString>
+
+#include <map>
+
+class QFileInfo;
+
+
+
+// Class that stores small copies of image files in a single file in the user's
+// cache directory, so that they need not be decoded again in later sessions.
+// A thumbnail is only valid if the image file still has the same size and
+// modification time. Thumbnails of files that no longer exist are dropped
+// when the cache is saved.
+class ThumbnailCache {
+public:
+    // Read the cache file. If it is missing or unreadable, start out empty.
+    void Load();
+    // Write the cache file, if anything changed since it was loaded.
+    void Save();
+
+    // Get the thumbnail for the given image file, or a null image if there is
+    // no thumbnail for the current version of it.
+    QImage Get(const QFileInfo &file) const;
+    void Set(const QFileInfo &file, const QImage &thumbnail);
+
+
+private:
+    class Entry {
+    public:
+        qint64 modified = 0;
+        qint64 size = 0;
+        QImage image;
+    };
+
+
+private:
+    std::map<QString, Entry> entries;
+    bool isChanged = false;
+};
+
+
+
+#endif // THUMBNAILCACHE_H
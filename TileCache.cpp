@@ -0,0 +1,192 @@
+/* TileCache.cpp
+Copyright (c) 2015 by Michael Zahniser
+
+Endless Sky is free software: you can redistribute it and/or modify it under the
+terms of the GNU General Public License as published by the Free Software
+Foundation, either version 3 of the License, or (at your option) any later version.
+
+Endless Sky is distributed in the hope that it will be useful, but WITHOUT ANY
+WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A
+PARTICULAR PURPOSE.  See the GNU General Public License for more details.
+*/
+
+#include "TileCache.h"
+
+#include <QPainter>
+#include <QRectF>
+
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <vector>
+
+using namespace std;
+
+
+
+// Switch to the given zoom level. If it is not the current zoom level, all
+// the cached tiles are discarded, but the most recent ones are kept around
+// to be drawn as placeholders until the new tiles are ready.
+void TileCache::SetScale(double scale)
+{
+    if(scale == this->scale)
+        return;
+
+    // If the zoom level changes again before any tiles were rendered, keep the
+    // older placeholders rather than replacing them with nothing.
+    bool hasImages = false;
+    for(const auto &it : tiles)
+        hasImages |= !it.second.image.isNull();
+    if(hasImages)
+    {
+        previous.clear();
+        previousScale = this->scale;
+        for(const auto &it : tiles)
+            if(!it.second.image.isNull())
+                previous[it.first] = it.second.image;
+    }
+
+    Clear();
+    this->scale = scale;
+}
+
+
+
+double TileCache::Scale() const
+{
+    return scale;
+}
+
+
+
+// Get the image for the given tile, or null if it has never been rendered.
+// The image may be out of date if the tile needs to be re-rendered.
+const QImage *TileCache::Get(int x, int y) const
+{
+    auto it = tiles.find(make_pair(x, y));
+    return (it == tiles.end() || it->second.image.isNull()) ? nullptr : &it->second.image;
+}
+
+
+
+// Check if the given tile is missing or out of date, and is not being rendered.
+bool TileCache::NeedsRender(int x, int y) const
+{
+    auto it = tiles.find(make_pair(x, y));
+    return (it == tiles.end() || (!it->second.isCurrent && !it->second.cancelled));
+}
+
+
+
+// Mark that the given tile is being rendered.
+TileCache::Ticket TileCache::Start(int x, int y)
+{
+    Tile &tile = tiles[make_pair(x, y)];
+    tile.cancelled.reset(new atomic<bool>(false));
+    tile.version = ++lastVersion;
+    return Ticket{tile.version, tile.cancelled};
+}
+
+
+
+// Store a finished render. It is ignored if the tile has been invalidated
+// since the render was started, or if a newer render has been started.
+void TileCache::Finish(int x, int y, int version, const QImage &image)
+{
+    auto it = tiles.find(make_pair(x, y));
+    if(it == tiles.end() || !version || it->second.version != version)
+        return;
+
+    it->second.image = image;
+    it->second.isCurrent = true;
+    it->second.cancelled.reset();
+}
+
+
+
+// Mark any tiles that overlap the given rectangle (in map coordinates) as
+// needing to be rendered again.
+void TileCache::Invalidate(const QRectF &bounds)
+{
+    QRect range = Range(QRectF(bounds.topLeft() * scale, bounds.bottomRight() * scale));
+    for(auto &it : tiles)
+        if(range.contains(it.first.first, it.first.second))
+        {
+            // Keep the old image to show until the new one is ready.
+            Cancel(it.second);
+            it.second.isCurrent = false;
+        }
+}
+
+
+
+void TileCache::Clear()
+{
+    for(auto &it : tiles)
+        Cancel(it.second);
+    tiles.clear();
+}
+
+
+
+// If more than the given number of tiles are cached, discard the ones that
+// are farthest from the given tile.
+void TileCache::Prune(int x, int y, unsigned count)
+{
+    if(tiles.size() <= count)
+        return;
+
+    // Sort the tiles by their (Chebyshev) distance from the given tile.
+    vector<pair<int, pair<int, int>>> distance;
+    for(const auto &it : tiles)
+        distance.emplace_back(max(abs(it.first.first - x), abs(it.first.second - y)), it.first);
+    nth_element(distance.begin(), distance.begin() + count, distance.end());
+
+    for(auto it = distance.begin() + count; it != distance.end(); ++it)
+    {
+        auto tile = tiles.find(it->second);
+        Cancel(tile->second);
+        tiles.erase(tile);
+    }
+}
+
+
+
+// Draw the tiles of the previous zoom level, scaled to the current one.
+// The painter should be translated so the origin is at map position (0, 0),
+// but not scaled. The given rectangle is the region to fill, in that space.
+void TileCache::DrawPrevious(QPainter &painter, const QRectF &visible) const
+{
+    if(previous.empty() || !previousScale)
+        return;
+
+    double size = SIZE * scale / previousScale;
+    for(const auto &it : previous)
+    {
+        QRectF target(it.first.first * size, it.first.second * size, size, size);
+        if(target.intersects(visible))
+            painter.drawImage(target, it.second);
+    }
+}
+
+
+
+// Get the (inclusive) range of tiles that covers the given rectangle, which
+// is in map coordinates multiplied by the current scale.
+QRect TileCache::Range(const QRectF &scaled)
+{
+    QRectF rect = scaled.normalized();
+    return QRect(
+        QPoint(floor(rect.left() / SIZE), floor(rect.top() / SIZE)),
+        QPoint(floor(rect.right() / SIZE), floor(rect.bottom() / SIZE)));
+}
+
+
+
+void TileCache::Cancel(Tile &tile)
+{
+    if(tile.cancelled)
+        *tile.cancelled = true;
+    tile.cancelled.reset();
+    tile.version = 0;
+}
@@ -0,0 +1,115 @@
+/* TileCache.h
+Copyright (c) 2015 by Michael Zahniser
+
+Endless Sky is free software: you can redistribute it and/or modify it under the
+terms of the GNU General Public License as published by the Free Software
+Foundation, either version 3 of the License, or (at your option) any later version.
+
+Endless Sky is distributed in the hope that it will be useful, but WITHOUT ANY
+WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A
+PARTICULAR PURPOSE.  See the GNU General Public License for more details.
+*/
+
+#ifndef TILECACHE_H
+#define TILECACHE_H
+
+#include <QImage>
+#include <QRect>
+
+#include <atomic>
+#include <map>
+#include <memory>
+#include <utility>
+
+class QPainter;
+class QRectF;
+
+
+
+// Class holding pre-rendered square tiles of a zoomable view. Tile (x, y)
+// covers the square from (x, y) * SIZE to (x + 1, y + 1) * SIZE, in map
+// coordinates multiplied by the current scale. Tiles are rendered elsewhere
+// (possibly in other threads); this class keeps track of which tiles are
+// missing or out of date, and which renders are still worth finishing.
+class TileCache {
+public:
+    // Width and height, in pixels, of each tile.
+    static const int SIZE = 256;
+
+    // Handle for a render that is in progress.
+    class Ticket {
+    public:
+        int version;
+        // This is set if the tile is invalidated before the render finishes.
+        std::shared_ptr<std::atomic<bool>> cancelled;
+    };
+
+
+public:
+    // Switch to the given zoom level. If it is not the current zoom level, all
+    // the cached tiles are discarded, but the most recent ones are kept around
+    // to be drawn as placeholders until the new tiles are ready.
+    void SetScale(double scale);
+    double Scale() const;
+
+    // Get the image for the given tile, or null if it has never been rendered.
+    // The image may be out of date if the tile needs to be re-rendered.
+    const QImage *Get(int x, int y) const;
+    // Check if the given tile is missing or out of date, and is not being rendered.
+    bool NeedsRender(int x, int y) const;
+    // Mark that the given tile is being rendered.
+    Ticket Start(int x, int y);
+    // Store a finished render. It is ignored if the tile has been invalidated
+    // (or discarded) since the render was started, or if a newer render of it
+    // has been started.
+    void Finish(int x, int y, int version, const QImage &image);
+
+    // Mark any tiles that overlap the given rectangle (in map coordinates) as
+    // needing to be rendered again.
+    void Invalidate(const QRectF &bounds);
+    void Clear();
+    // If more than the given number of tiles are cached, discard the ones that
+    // are farthest from the given tile.
+    void Prune(int x, int y, unsigned count);
+
+    // Draw the tiles of the previous zoom level, scaled to the current one.
+    // The painter should be translated so the origin is at map position (0, 0),
+    // but not scaled. The given rectangle is the region to fill, in that space.
+    void DrawPrevious(QPainter &painter, const QRectF &visible) const;
+
+    // Get the (inclusive) range of tiles that covers the given rectangle, which
+    // is in map coordinates multiplied by the current scale.
+    static QRect Range(const QRectF &scaled);
+
+
+private:
+    class Tile {
+    public:
+        QImage image;
+        // The version of the most recent render that was started, or 0 if the
+        // tile has been invalidated since then.
+        int version = 0;
+        bool isCurrent = false;
+        std::shared_ptr<std::atomic<bool>> cancelled;
+    };
+
+
+private:
+    void Cancel(Tile &tile);
+
+
+private:
+    double scale = 0.;
+    std::map<std::pair<int, int>, Tile> tiles;
+    // Each render gets a version number that has never been used before, so
+    // that a tile that is discarded and then made again cannot mistake an old
+    // render for its own.
+    int lastVersion = 0;
+
+    double previousScale = 0.;
+    std::map<std::pair<int, int>, QImage> previous;
+};
+
+
+
+#endif // TILECACHE_H
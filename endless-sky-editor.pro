@@ -12,6 +12,13 @@ TARGET = endless-sky-editor
 TEMPLATE = app
 CONFIG += c++11
 
+# qmake's release builds default to -O2, which does not vectorize the orbit
+# loops in Orbits.cpp on older GCC versions.
+*-g++*|*-clang* {
+    QMAKE_CXXFLAGS_RELEASE -= -O2
+    QMAKE_CXXFLAGS_RELEASE += -O3
+}
+
 target.path = /usr/games/
 INSTALLS += target
 
@@ -39,17 +46,27 @@ SOURCES += main.cpp\
     MainWindow.cpp\
     Planet.cpp\
     StellarObject.cpp\
+    SpriteCatalog.cpp \
     System.cpp \
     SystemView.cpp \
     Map.cpp \
+    Orbits.cpp \
     SpriteSet.cpp \
+    SpriteQueue.cpp \
+    SpriteIndex.cpp \
+    SpriteAtlas.cpp \
+    ThumbnailCache.cpp \
+    CommodityRandomizer.cpp \
     GalaxyView.cpp \
     Galaxy.cpp \
+    GalaxyScene.cpp \
     DetailView.cpp \
     AsteroidField.cpp \
     PlanetView.cpp \
+    Random.cpp \
     LandscapeView.cpp \
-    LandscapeLoader.cpp
+    LandscapeLoader.cpp \
+    TileCache.cpp
 
 HEADERS  += DataFile.h\
     DataNode.h\
@@ -57,15 +74,25 @@ HEADERS  += DataFile.h\
     MainWindow.h\
     Planet.h\
     StellarObject.h\
+    SpriteCatalog.h \
     System.h \
     SystemView.h \
     Map.h \
+    Orbits.h \
     SpriteSet.h \
+    SpriteQueue.h \
+    SpriteIndex.h \
+    SpriteAtlas.h \
+    ThumbnailCache.h \
+    CommodityRandomizer.h \
     GalaxyView.h \
     Galaxy.h \
+    GalaxyScene.h \
     DetailView.h \
     AsteroidField.h \
     PlanetView.h \
+    Random.h \
     LandscapeView.h \
     LandscapeLoader.h \
+    TileCache.h \
     pi.h
@@ -12,6 +12,7 @@ PARTICULAR PURPOSE.  See the GNU General Public License for more details.
 
 #include "MainWindow.h"
 #include "Map.h"
+#include "SpriteAtlas.h"
 #include "SpriteSet.h"
 
 #include <QApplication>
@@ -19,7 +20,9 @@ PARTICULAR PURPOSE.  See the GNU General Public License for more details.
 #include <QFileOpenEvent>
 #include <QString>
 
+#include <algorithm>
 #include <iostream>
+#include <limits>
 
 using namespace std;
 
@@ -59,6 +62,19 @@ int main(int argc, char *argv[])
             PrintVersion();
             return 0;
         }
+        else if((arg == "-c" || arg == "--cache") && i + 1 < argc)
+        {
+            bool ok = false;
+            qint64 megabytes = QString(argv[++i]).toLongLong(&ok);
+            if(!ok || megabytes <= 0)
+            {
+                PrintHelp();
+                return 0;
+            }
+            SpriteSet::SetBudget(min(megabytes, numeric_limits<qint64>::max() >> 20) << 20);
+        }
+        else if(arg == "-a" || arg == "--atlas")
+            SpriteAtlas::Enable();
         else if(arg[0] != '-')
             path = arg;
         else
@@ -102,6 +118,8 @@ void PrintHelp()
     cerr << "Command line options:" << endl;
     cerr << "    -h, --help: print this help message." << endl;
     cerr << "    -v, --version: print version information." << endl;
+    cerr << "    -c, --cache <megabytes>: limit the memory used for loaded images." << endl;
+    cerr << "    -a, --atlas: keep decoded sprites in a memory-mapped file in the cache." << endl;
     cerr << "    <path to map.txt>: load the given map file." << endl;
     cerr << "        Sprites are then loaded from ../images/ relative to the map file." << endl;
     cerr << endl;